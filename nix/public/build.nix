@@ -14,23 +14,32 @@ let
   lib = pkgs.lib;
 
   testNames = [
+    "cache-contention"
+    "console-throughput"
     "cpuid"
+    "dirty-rate"
     "emulator-syscall"
     "exceptions"
+    "first-touch"
     "fpu"
     "hello-world"
     "lapic-modes"
     "lapic-priority"
     "lapic-timer"
+    "memory-bandwidth"
+    "memory-types"
     "msr"
+    "page-walk"
     "pagefaults"
     "pit-timer"
+    "serial-tx-irq"
     "sgx"
     "sgx-launch-control"
     "timing"
     "tsc"
     "tinivisor"
     "vmx"
+    "work-stealing"
   ];
 
   cmakeProj =
@@ -26,3 +26,12 @@
 #define STACK_SIZE_VIRT (1 << STACK_BITS_VIRT)
 
 #define HEAP_ALIGNMENT (0x10)
+
+/** Upper bound for the number of CPUs. Per-CPU storage is statically sized with this value. */
+#define MAX_CPUS (64)
+
+/** Stack size of each application processor. */
+#define AP_STACK_SIZE (4 * PAGE_SIZE)
+
+/** Physical address below 1 MiB where the AP startup trampoline is placed. Must be page aligned. */
+#define AP_TRAMPOLINE_ADDR (0x8000)
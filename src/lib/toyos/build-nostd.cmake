@@ -2,18 +2,26 @@
 
 add_library(
   toyos STATIC
+  src/ap_boot.S
+  src/binary_trace.cpp
   src/boot.cpp
+  src/console_memory.cpp
   src/console_serial.cpp
   src/console_serial_util.cpp
+  src/console_virtio.cpp
   src/init.S
   src/mm.cpp
+  src/panic.cpp
   src/pd.cpp
   src/pdpt.cpp
+  src/per_cpu.cpp
   src/pml4.cpp
   src/pt.cpp
+  src/smp.cpp
   src/string_util.cpp
   src/tinivisor.cpp
   src/vmxexit.S
+  src/work_stealing.cpp
   src/baretest/baretest.cpp
   src/baretest/baretest_config.cpp
   src/baretest/print.cpp
@@ -46,4 +54,9 @@ target_compile_options(
 # for first-fit-heap
 target_compile_definitions(toyos PUBLIC HEAP_FREESTANDING HEAP_ASSERT)
 
+option(TOYOS_TLSF_HEAP "Use the TLSF heap instead of the first-fit heap" OFF)
+if(TOYOS_TLSF_HEAP)
+  target_compile_definitions(toyos PRIVATE TOYOS_TLSF_HEAP)
+endif()
+
 target_link_libraries(toyos PUBLIC libcxx pprintpp optionparser first-fit-heap)
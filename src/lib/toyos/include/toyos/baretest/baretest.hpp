@@ -30,8 +30,15 @@ namespace baretest
         const char* name;
         test_case_fn fn_;
 
-        test_case(test_suite& suite, const char* name, test_case_fn tc);
+        // The test case only touches state of the CPU it runs on and may run
+        // on an AP concurrently to other such test cases.
+        bool cpu_local;
+
+        test_case(test_suite& suite, const char* name, test_case_fn tc, bool cpu_local = false);
         bool run() const;
+
+        /// Prints the result of a test case execution and returns true on success.
+        bool report(result_t res) const;
     };
 
     class test_suite
@@ -39,6 +46,14 @@ namespace baretest
      private:
         std::vector<test_case> test_cases;
 
+        /**
+         * Runs the CPU-local test cases in [first, last) on all APs.
+         *
+         * The results and the output of the test cases are reported in order
+         * by the calling CPU.
+         */
+        void run_parallel(size_t first, size_t last);
+
      public:
         void add(test_case tc)
         {
@@ -61,37 +76,58 @@ namespace baretest
      */
     bool testcase_disabled_by_cmdline(const std::string_view& name);
 
+    /**
+     * Collects all console output in memory until resume_console() is called.
+     *
+     * The collected output is written to the real consoles between test cases
+     * and at the end of the test run, so console accesses do not perturb
+     * timing-sensitive test cases.
+     */
+    void pause_console();
+    void resume_console();
+
 }  // namespace baretest
 
-#define TEST_CASE_CONDITIONAL(test_name, condition)                           \
-    static baretest::test_case::result_t test_##test_name();                  \
-    static void test_impl_##test_name();                                      \
-    namespace baretest                                                        \
-    {                                                                         \
-        test_case tc_##test_name(get_suite(), #test_name, &test_##test_name); \
-    }                                                                         \
-    baretest::test_case::result_t test_##test_name()                          \
-    {                                                                         \
-        printf("test case: %s\n", __func__);                                  \
-        if (not(condition)) {                                                 \
-            printf("- skipping as condition is NOT met: `" #condition "`\n"); \
-            return baretest::test_case::result_t::SKIPPED;                    \
-        }                                                                     \
-        if (baretest::testcase_disabled_by_cmdline(#test_name)) {             \
-            printf("- skipping as test case is disabled via cmdline\n");      \
-            return baretest::test_case::result_t::SKIPPED;                    \
-        }                                                                     \
-        int val = setjmp(baretest::get_env());                                \
-        if (val) {                                                            \
-            return baretest::test_case::result_t::FAILURE;                    \
-        }                                                                     \
-        test_impl_##test_name();                                              \
-        return baretest::test_case::result_t::SUCCESS;                        \
-    }                                                                         \
+#define TEST_CASE_IMPL(test_name, condition, cpu_local)                                  \
+    static baretest::test_case::result_t test_##test_name();                             \
+    static void test_impl_##test_name();                                                 \
+    namespace baretest                                                                   \
+    {                                                                                    \
+        test_case tc_##test_name(get_suite(), #test_name, &test_##test_name, cpu_local); \
+    }                                                                                    \
+    baretest::test_case::result_t test_##test_name()                                     \
+    {                                                                                    \
+        printf("test case: %s\n", __func__);                                             \
+        if (not(condition)) {                                                            \
+            printf("- skipping as condition is NOT met: `" #condition "`\n");            \
+            return baretest::test_case::result_t::SKIPPED;                               \
+        }                                                                                \
+        if (baretest::testcase_disabled_by_cmdline(#test_name)) {                        \
+            printf("- skipping as test case is disabled via cmdline\n");                 \
+            return baretest::test_case::result_t::SKIPPED;                               \
+        }                                                                                \
+        int val = setjmp(baretest::get_env());                                           \
+        if (val) {                                                                       \
+            return baretest::test_case::result_t::FAILURE;                               \
+        }                                                                                \
+        test_impl_##test_name();                                                         \
+        return baretest::test_case::result_t::SUCCESS;                                   \
+    }                                                                                    \
     void test_impl_##test_name()
 
+#define TEST_CASE_CONDITIONAL(test_name, condition) TEST_CASE_IMPL(test_name, condition, false)
 #define TEST_CASE(test_name) TEST_CASE_CONDITIONAL(test_name, true)
 
+/**
+ * Declares a test case that may run on an AP in parallel to other CPU-local
+ * test cases if parallel execution is enabled via the cmdline.
+ *
+ * Such test cases must only touch state of the CPU they run on, e.g. CPUID
+ * or MSR values, and must not modify global data.
+ */
+#define TEST_CASE_CPU_LOCAL_CONDITIONAL(test_name, condition) TEST_CASE_IMPL(test_name, condition, true)
+#define TEST_CASE_CPU_LOCAL(test_name) TEST_CASE_CPU_LOCAL_CONDITIONAL(test_name, true)
+
 /**
  * Print information about environment, such as the command line of the test.
  */
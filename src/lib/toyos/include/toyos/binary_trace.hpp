@@ -0,0 +1,159 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <toyos/per_cpu.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+/**
+ * Deferred binary tracing.
+ *
+ * info() and trace() format their output right away, which takes thousands
+ * of cycles and perturbs timing-sensitive tests. A deferred trace point only
+ * stores an identifier of its call site, the TSC and its raw arguments in a
+ * per-CPU ring. Formatting happens when the ring is dumped, which baretest
+ * does at the end of a test run and after a failed test case.
+ *
+ * The rings have to be allocated with prepare() outside of the measured code.
+ *
+ * Arguments have to be integers, enums or pointers. Strings are stored as
+ * pointers, so they have to outlive the trace, e.g. string literals.
+ *
+ * Example:
+ *
+ *   deferred_info("deadline {} missed by {} cycles", deadline, late);
+ */
+namespace binary_trace
+{
+
+    static constexpr size_t MAX_ARGS{ 5 };
+    static constexpr size_t RING_RECORDS{ 256 };
+
+    struct record;
+
+    /// Formats a record. Every call site gets its own instance, so its address identifies the format.
+    using replay_fn = void (*)(const record&);
+
+    struct record
+    {
+        replay_fn replay;
+        uint64_t tsc;
+        std::array<uint64_t, MAX_ARGS> args;
+    };
+
+    /// The trace of a single CPU. The oldest records are overwritten.
+    struct ring
+    {
+        uint64_t head;
+        std::array<record, RING_RECORDS> records;
+    };
+
+    /// The rings are allocated by prepare(), so trace points never allocate memory.
+    extern per_cpu<ring*> rings;
+
+    /// Trace points that were dropped, because their CPU had no ring.
+    extern per_cpu<uint64_t> dropped;
+
+    /**
+     * Allocates the rings of all online CPUs.
+     *
+     * smp::start_aps() calls this for the CPUs it starts. Tests that trace
+     * only on the BSP call it from their prologue. Calling it again only
+     * allocates rings of CPUs that don't have one yet.
+     */
+    void prepare();
+
+    /**
+     * Prints all recorded trace points in TSC order and empties the rings.
+     *
+     * Other CPUs must not record trace points meanwhile.
+     */
+    void dump();
+
+    template<typename T>
+    inline uint64_t to_raw(T arg)
+    {
+        static_assert(std::is_integral_v<T> or std::is_enum_v<T> or std::is_pointer_v<T>,
+                      "Only integers, enums and pointers can be traced");
+
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<uintptr_t>(arg);
+        }
+        else {
+            return static_cast<uint64_t>(arg);
+        }
+    }
+
+    template<typename T>
+    inline T from_raw(uint64_t raw)
+    {
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<T>(raw);
+        }
+        else {
+            return static_cast<T>(raw);
+        }
+    }
+
+    template<typename SITE, typename FMT, typename... Ts, size_t... I>
+    void replay_args(const record& r, std::index_sequence<I...>)
+    {
+        printf("[TRC %s:%d] ", SITE::file(), SITE::line());
+        printf(FMT::str(), from_raw<Ts>(r.args[I])...);
+        printf("\n");
+    }
+
+    template<typename SITE, typename FMT, typename... Ts>
+    void replay(const record& r)
+    {
+        replay_args<SITE, FMT, Ts...>(r, std::index_sequence_for<Ts...>{});
+    }
+
+    template<typename SITE, typename FMT, typename... Ts>
+    inline void emit(Ts... args)
+    {
+        static_assert(sizeof...(Ts) <= MAX_ARGS, "Too many arguments for a deferred trace point");
+
+        auto* r{ rings.local() };
+        if (UNLIKELY(r == nullptr)) {
+            dropped.local()++;
+            return;
+        }
+
+        auto& rec{ r->records[r->head++ % RING_RECORDS] };
+
+        rec.replay = &replay<SITE, FMT, Ts...>;
+        rec.tsc = rdtsc();
+
+        [[maybe_unused]] size_t i{ 0 };
+        ((rec.args[i++] = to_raw(args)), ...);
+    }
+
+}  // namespace binary_trace
+
+#define deferred_info(fmtstr, ...)                                                                 \
+    do {                                                                                           \
+        struct binary_trace_site                                                                   \
+        {                                                                                          \
+            static constexpr const char* str() { return fmtstr; }                                  \
+            static constexpr const char* file() { return strip_file_path(__FILE__); }              \
+            static constexpr int line() { return __LINE__; }                                       \
+        };                                                                                         \
+        using binary_trace_types = decltype(pprintpp::tie_types(__VA_ARGS__));                     \
+        using binary_trace_format = pprintpp::autoformat_t<binary_trace_site, binary_trace_types>; \
+        binary_trace::emit<binary_trace_site, binary_trace_format>(__VA_ARGS__);                   \
+    } while (0);
+
+#define deferred_trace(context, fmtstr, ...)         \
+    do {                                             \
+        if ((TRACE_MASK & (context)) == (context)) { \
+            deferred_info(fmtstr, ##__VA_ARGS__);    \
+        }                                            \
+    } while (0);
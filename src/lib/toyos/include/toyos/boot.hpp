@@ -14,6 +14,13 @@ enum class boot_method
 
 std::string_view boot_method_name(boot_method method);
 
+class slab_allocator;
+
+/**
+ * The slab caches that serve small allocations of operator new.
+ */
+const slab_allocator& small_object_allocator();
+
 /**
  * The chosen boot method.
  */
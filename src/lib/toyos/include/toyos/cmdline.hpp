@@ -23,6 +23,7 @@ namespace cmdline
     namespace optionparser
     {
         constexpr char DISABLED_TESTCASES_DELIMITER = ',';
+        constexpr char LIST_DELIMITER = ',';
 
         /**
          * Index into the `usage` array.
@@ -32,7 +33,12 @@ namespace cmdline
             SERIAL,
             XHCI,
             XHCI_POWER,
+            VIRTIO_CONSOLE,
             DISABLED_TESTCASES,
+            PARALLEL_TESTCASES,
+            LATENCY_WORKING_SETS,
+            DIRTY_RATE,
+            DIRTY_PATTERNS,
         };
 
         /**
@@ -45,7 +51,12 @@ namespace cmdline
             { SERIAL, 0, "", "serial", option::Arg::Optional, "" },
             { XHCI, 0, "", "xhci", option::Arg::Optional, "" },
             { XHCI_POWER, 0, "", "xhci-power", option::Arg::Optional, "" },
+            { VIRTIO_CONSOLE, 0, "", "virtio-console", option::Arg::None, "" },
             { DISABLED_TESTCASES, 0, "", "disable-testcases", option::Arg::Optional, "" },
+            { PARALLEL_TESTCASES, 0, "", "parallel-testcases", option::Arg::None, "" },
+            { LATENCY_WORKING_SETS, 0, "", "latency-working-sets", option::Arg::Optional, "" },
+            { DIRTY_RATE, 0, "", "dirty-rate", option::Arg::Optional, "" },
+            { DIRTY_PATTERNS, 0, "", "dirty-patterns", option::Arg::Optional, "" },
 
             { 0, 0, nullptr, nullptr, nullptr, nullptr }
         };
@@ -117,6 +128,14 @@ namespace cmdline
             return option_value(optionparser::option_index::XHCI_POWER).value_or("0");
         }
 
+        /**
+         * Returns true if the virtio-console cmdline flag is present.
+         */
+        bool virtio_console_option()
+        {
+            return option_value(optionparser::option_index::VIRTIO_CONSOLE).has_value();
+        }
+
         /**
          * Returns the disable-testcases cmdline modifier or the default.
          */
@@ -126,6 +145,40 @@ namespace cmdline
             return util::string::split(disabled_testcases_str, cmdline::optionparser::DISABLED_TESTCASES_DELIMITER);
         }
 
+        /**
+         * Returns true if the parallel-testcases cmdline flag is present.
+         */
+        bool parallel_testcases_option()
+        {
+            return option_value(optionparser::option_index::PARALLEL_TESTCASES).has_value();
+        }
+
+        /**
+         * Returns the latency-working-sets cmdline modifier or an empty list.
+         */
+        std::vector<std::string> latency_working_sets_option()
+        {
+            auto working_sets_str = option_value(optionparser::option_index::LATENCY_WORKING_SETS).value_or("");
+            return util::string::split(working_sets_str, cmdline::optionparser::LIST_DELIMITER);
+        }
+
+        /**
+         * Returns the dirty-rate cmdline modifier or the default.
+         */
+        std::string dirty_rate_option()
+        {
+            return option_value(optionparser::option_index::DIRTY_RATE).value_or("0");
+        }
+
+        /**
+         * Returns the dirty-patterns cmdline modifier or an empty list.
+         */
+        std::vector<std::string> dirty_patterns_option()
+        {
+            auto patterns_str = option_value(optionparser::option_index::DIRTY_PATTERNS).value_or("");
+            return util::string::split(patterns_str, cmdline::optionparser::LIST_DELIMITER);
+        }
+
      private:
         std::vector<std::string> arguments;
         std::vector<const char*> argv;
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "cstddef"
 #include "optional"
 #include "string"
 
@@ -22,6 +23,15 @@ class console
 
     virtual void putc(char c) = 0;
 
+    /// Write a chunk of output. Consoles that can transfer more than one
+    /// character at once should override this.
+    virtual void write(const char* data, size_t size)
+    {
+        for (size_t i{ 0 }; i < size; i++) {
+            putc(data[i]);
+        }
+    }
+
     static bool is_line_ending(const char c)
     {
         return c == '\n' or c == '\r';
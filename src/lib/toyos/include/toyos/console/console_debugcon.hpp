@@ -20,17 +20,27 @@ namespace debugcon
 {
     constexpr uint16_t IO_PORT = 0xe9;
 
-    void putc(unsigned char c)
+    inline void putc(unsigned char c)
     {
         outb(IO_PORT, c);
     }
+
+    /**
+     * Emits a whole buffer with `rep outsb`. VMMs that handle string I/O
+     * natively process the buffer with a single exit instead of one exit per
+     * byte.
+     */
+    inline void write(const char* data, size_t size)
+    {
+        outsb(IO_PORT, data, size);
+    }
 }  // namespace debugcon
 
 namespace console_debugcon
 {
     static void init()
     {
-        add_printf_backend(debugcon::putc);
+        add_printf_backend(debugcon::putc, debugcon::write);
         info("Initialized QEMU debugcon console");
     }
 
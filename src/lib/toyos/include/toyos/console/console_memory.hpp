@@ -0,0 +1,45 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Module for capturing console output in memory.
+ *
+ * Every byte that goes to a real console may cause VM exits or wait for slow
+ * hardware, which perturbs timing-sensitive measurements. While output is
+ * paused, the memory console is the only printf backend and collects all
+ * output in a preallocated ring. The captured output is written to the real
+ * consoles when output is resumed or flushed.
+ *
+ * If the ring overflows, the oldest output is dropped and the number of
+ * dropped bytes is reported with the next flush.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace memory_console
+{
+    static constexpr size_t CAPACITY{ 512 * 1024 };
+
+    /// Redirects all output into memory until resume() is called.
+    void pause();
+
+    /// Writes the captured output to the real consoles and restores them.
+    void resume();
+
+    /// Writes the captured output to the real consoles, but keeps capturing.
+    void flush();
+
+    /// Returns true while output is captured.
+    bool paused();
+
+    /// Returns the number of bytes that were dropped because the ring was full.
+    uint64_t dropped_bytes();
+
+    void putchar(unsigned char c);
+    void write_buffer(const char* data, size_t size);
+
+}  // namespace memory_console
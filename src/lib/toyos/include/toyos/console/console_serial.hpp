@@ -13,6 +13,7 @@
 #include "toyos/pci/bus.hpp"
 #include "toyos/util/algorithm.hpp"
 #include "toyos/util/interval.hpp"
+#include "toyos/util/lock_free_queue.hpp"
 #include "toyos/x86/arch.hpp"
 #include <config.hpp>
 
@@ -21,6 +22,20 @@ class console_serial_base : public console
  protected:
     uint16_t base{ 0 };
 
+    // Number of bytes we may write once THB_EMPTY is set.
+    size_t fifo_depth_{ 1 };
+
+    // Transmit buffer for interrupt-driven mode
+    static constexpr size_t TX_RING_SIZE{ 4096 };
+    cbl::static_lock_free_queue<char, TX_RING_SIZE> tx_ring_;
+    bool tx_irq_mode_{ false };
+
+    /// Waits until the transmitter can take new data. Returns false on timeout.
+    bool wait_for_thb_empty();
+
+    /// Writes up to fifo_depth_ bytes from the transmit ring to the UART.
+    void fill_fifo_from_ring();
+
  public:
     struct console_info
     {
@@ -68,6 +83,11 @@ class console_serial_base : public console
         IIR_SEND = 1u << 1,
 
         IIR_FIFO_ENABLED = 3u << 6,
+        IIR_ID_MASK = 7u << 0,
+
+        // A 16550A has a 16-byte FIFO. Older chips either have none or a
+        // broken one, in which case IIR_FIFO_ENABLED is not fully set.
+        FIFO_DEPTH_16550A = 16,
 
         MCR_IRQ = 1u << 3,
 
@@ -89,6 +109,39 @@ class console_serial_base : public console
     }
 
     virtual void putc(char c) override;
+
+    /**
+     * Writes a chunk of data.
+     *
+     * In polling mode, every wait for THB_EMPTY is followed by as many bytes
+     * as the FIFO can hold. In interrupt-driven mode, the data is queued and
+     * sent from handle_irq().
+     */
+    virtual void write(const char* data, size_t size) override;
+
+    /// Returns the size of the transmit FIFO that was detected during initialization.
+    size_t fifo_depth() const
+    {
+        return fifo_depth_;
+    }
+
+    /**
+     * Switches between polled and interrupt-driven transmission.
+     *
+     * The caller is responsible for routing the serial IRQ to the CPU that
+     * writes to the console and for calling handle_irq() from the interrupt
+     * handler. When switching back to polling, queued data is sent first.
+     */
+    void set_tx_irq_mode(bool enabled);
+
+    /// Refills the transmit FIFO from the transmit buffer. To be called from the serial interrupt handler.
+    void handle_irq();
+
+    /// Returns true while queued output waits for the transmitter in interrupt-driven mode.
+    bool tx_pending() const
+    {
+        return not tx_ring_.empty();
+    }
 };
 
 class console_serial final : public console_serial_base
@@ -103,6 +156,13 @@ class console_serial final : public console_serial_base
     }
 
     static void putchar(unsigned char c);
+    static void write_buffer(const char* data, size_t size);
+
+    /// Returns true iff a serial console was initialized with serial_init().
+    static bool is_active();
+
+    /// Returns the console that was initialized with serial_init() or nullptr.
+    static console_serial* active();
 };
 
 struct bda_serial_config
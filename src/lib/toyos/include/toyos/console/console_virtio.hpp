@@ -0,0 +1,171 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "console.hpp"
+#include "toyos/pci/device.hpp"
+#include "toyos/util/interval.hpp"
+#include "toyos/x86/arch.hpp"
+
+/**
+ * Output via a virtio-console device on the modern virtio-PCI transport.
+ *
+ * Output is collected in buffers that the device reads via DMA. A buffer is
+ * handed to the transmit queue of port 0 when it is full or when a line is
+ * complete. Several buffers can be in flight, so the CPU only waits for the
+ * device if all of them are.
+ *
+ * Reference: Virtual I/O Device (VIRTIO) Version 1.1,
+ *            Sections 2.6 (Split Virtqueues), 4.1 (Virtio Over PCI Bus)
+ *            and 5.3 (Console Device)
+ */
+class console_virtio final : public console
+{
+ public:
+    static constexpr uint16_t VENDOR_ID{ 0x1af4 };
+    static constexpr uint16_t DEVICE_ID_TRANSITIONAL{ 0x1003 };
+    static constexpr uint16_t DEVICE_ID_MODERN{ 0x1043 };
+
+    // Number of transmit buffers and thus descriptors in the queue
+    static constexpr size_t TX_QUEUE_SIZE{ 16 };
+    static constexpr size_t TX_BUF_SIZE{ PAGE_SIZE };
+
+    // One page for the virtqueue, followed by the transmit buffers
+    static constexpr size_t DMA_PAGES{ 1 + TX_QUEUE_SIZE * TX_BUF_SIZE / PAGE_SIZE };
+
+    /// Indicates if dev is a virtio-console device.
+    static bool is_virtio_console(const pci_device& dev)
+    {
+        return dev.vendor_id() == VENDOR_ID and (dev.device_id() == DEVICE_ID_TRANSITIONAL or dev.device_id() == DEVICE_ID_MODERN);
+    }
+
+    /**
+     * Initializes the device and its transmit queue.
+     *
+     * \param dev        The virtio-console PCI device. Its BARs have to be
+     *                   assigned and identity-mapped.
+     * \param dma_region An identity-mapped region of at least DMA_PAGES pages.
+     */
+    console_virtio(const pci_device& dev, const cbl::interval& dma_region);
+
+    /// Returns true if the device accepted the driver.
+    bool ready() const
+    {
+        return ready_;
+    }
+
+    virtual void puts(const std::string& str) override
+    {
+        write(str.data(), str.size());
+    }
+
+    virtual void putc(char c) override;
+
+    virtual void write(const char* data, size_t size) override;
+
+    /// Hands the current buffer to the device.
+    void flush();
+
+    static void putchar(unsigned char c);
+    static void write_buffer(const char* data, size_t size);
+
+    /// Returns true iff a virtio console was initialized with virtio_console_init().
+    static bool is_active();
+
+ private:
+    struct virtq_desc
+    {
+        uint64_t addr;
+        uint32_t len;
+        uint16_t flags;
+        uint16_t next;
+    };
+
+    struct virtq_avail
+    {
+        uint16_t flags;
+        uint16_t idx;
+        uint16_t ring[TX_QUEUE_SIZE];
+    };
+
+    struct virtq_used_elem
+    {
+        uint32_t id;
+        uint32_t len;
+    };
+
+    struct virtq_used
+    {
+        uint16_t flags;
+        uint16_t idx;
+        virtq_used_elem ring[TX_QUEUE_SIZE];
+    };
+
+    struct virtq
+    {
+        alignas(16) virtq_desc desc[TX_QUEUE_SIZE];
+        alignas(2) virtq_avail avail;
+        alignas(4) virtq_used used;
+    };
+    static_assert(sizeof(virtq) <= PAGE_SIZE, "The virtqueue must fit into one page");
+
+    /// The common configuration structure of the virtio-PCI transport
+    struct common_cfg
+    {
+        uint32_t device_feature_select;
+        uint32_t device_feature;
+        uint32_t driver_feature_select;
+        uint32_t driver_feature;
+        uint16_t msix_config;
+        uint16_t num_queues;
+        uint8_t device_status;
+        uint8_t config_generation;
+        uint16_t queue_select;
+        uint16_t queue_size;
+        uint16_t queue_msix_vector;
+        uint16_t queue_enable;
+        uint16_t queue_notify_off;
+        uint32_t queue_desc_lo;
+        uint32_t queue_desc_hi;
+        uint32_t queue_driver_lo;
+        uint32_t queue_driver_hi;
+        uint32_t queue_device_lo;
+        uint32_t queue_device_hi;
+    };
+    static_assert(sizeof(common_cfg) == 56, "Wrong common configuration layout");
+
+    bool find_structures(const pci_device& dev);
+    bool setup_tx_queue();
+
+    /// Marks the buffers that the device has consumed as free.
+    void reclaim_buffers();
+
+    char* tx_buffer(size_t slot) const
+    {
+        return reinterpret_cast<char*>(dma_base_ + PAGE_SIZE + slot * TX_BUF_SIZE);
+    }
+
+    uintptr_t dma_base_;
+    virtq& queue_;
+
+    volatile common_cfg* common_{ nullptr };
+    volatile uint16_t* notify_{ nullptr };
+
+    // Transmit buffers that the device has not returned yet
+    std::array<bool, TX_QUEUE_SIZE> in_flight_{};
+    uint16_t last_used_idx_{ 0 };
+
+    size_t current_slot_{ 0 };
+    size_t current_length_{ 0 };
+
+    bool ready_{ false };
+};
+
+/// Registers a ready virtio console as printf backend.
+void virtio_console_init(console_virtio& cons);
@@ -6,9 +6,11 @@
 #include <toyos/util/interval.hpp>
 #include <toyos/util/math.hpp>
 #include <toyos/util/order_range.hpp>
+#include <toyos/util/trace.hpp>
 
 #include <optional>
 #include <set>
+#include <utility>
 #include <vector>
 
 /**
@@ -197,9 +199,12 @@ class buddy_impl
  public:
     /**
      * The buddy is created without memory, memory is added by free()-ing it.
+     *
+     * Further arguments are passed to the block manager.
      */
-    explicit buddy_impl(uint64_t max_ord)
-        : max_order(max_ord), blocks(max_order)
+    template<typename... ARGS>
+    explicit buddy_impl(uint64_t max_ord, ARGS&&... block_manager_args)
+        : max_order(max_ord), blocks(max_order, std::forward<ARGS>(block_manager_args)...)
     {
         ASSERT(max_order <= maximal_order, "Bad maximal order");
     }
@@ -0,0 +1,134 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/util/interval.hpp>
+#include <toyos/util/math.hpp>
+#include <toyos/util/trace.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/**
+ * \brief A heap that consists of several independent heap regions
+ *
+ * Every region is managed by its own HEAP, which is created from a MEMORY
+ * object that describes the region. Both objects are placed at the start of
+ * the region itself, so adding a region never allocates.
+ *
+ * When no region can serve an allocation, the heap asks its grow function for
+ * more memory and adds it as a new region.
+ *
+ * \tparam HEAP        The heap that manages a single region, e.g. first_fit_heap.
+ * \tparam MEMORY      Describes a region. Constructible from base and size.
+ * \tparam MAX_REGIONS The maximal number of regions.
+ */
+template<class HEAP, class MEMORY, size_t MAX_REGIONS = 32>
+class growable_heap
+{
+ public:
+    /// Returns memory of at least the given size or an empty interval.
+    using grow_fn = cbl::interval (*)(size_t min_size);
+
+    explicit growable_heap(grow_fn grow = nullptr)
+        : grow_(grow)
+    {}
+
+    /// Adds a region to the heap. Returns false if there are too many regions or the region is too small.
+    bool add_region(uintptr_t base, size_t size)
+    {
+        auto mem_obj{ math::align_up(base, math::order_max(alignof(MEMORY))) };
+        auto heap_obj{ math::align_up(mem_obj + sizeof(MEMORY), math::order_max(alignof(HEAP))) };
+        auto heap_base{ math::align_up(heap_obj + sizeof(HEAP), math::order_max(alignof(std::max_align_t))) };
+        if (count == MAX_REGIONS or base + size <= heap_base) {
+            return false;
+        }
+
+        auto* mem{ new (reinterpret_cast<void*>(mem_obj)) MEMORY(heap_base, base + size - heap_base) };
+        auto* heap{ new (reinterpret_cast<void*>(heap_obj)) HEAP(*mem) };
+
+        regions[count++] = { cbl::interval(heap_base, base + size), heap };
+        return true;
+    }
+
+    /// Returns memory of at least the given size or nullptr if the heap cannot grow anymore.
+    void* alloc(size_t size)
+    {
+        if (auto* p{ alloc_from_regions(size) }; p != nullptr) {
+            return p;
+        }
+
+        if (grow_ == nullptr) {
+            return nullptr;
+        }
+
+        // Leave room for the heap objects and block headers.
+        auto mem{ grow_(size + size / 8 + REGION_OVERHEAD + GROW_SLACK) };
+        if (mem.empty() or not add_region(mem.a, mem.size())) {
+            return nullptr;
+        }
+
+        return regions[count - 1].heap->alloc(size);
+    }
+
+    /// Returns memory to the region it came from. Other pointers are ignored.
+    void free(void* p)
+    {
+        auto addr{ reinterpret_cast<uintptr_t>(p) };
+        for (size_t i{ 0 }; i < count; i++) {
+            if (regions[i].range.contains(addr)) {
+                regions[i].heap->free(p);
+                return;
+            }
+        }
+    }
+
+    size_t free_mem() const
+    {
+        size_t bytes{ 0 };
+        for (size_t i{ 0 }; i < count; i++) {
+            bytes += regions[i].heap->free_mem();
+        }
+        return bytes;
+    }
+
+    size_t num_regions() const
+    {
+        return count;
+    }
+
+    size_t alignment() const
+    {
+        ASSERT(count > 0, "Heap without regions");
+        return regions[0].heap->alignment();
+    }
+
+ private:
+    // The heap objects at the start of a region including alignment
+    static constexpr size_t REGION_OVERHEAD{ sizeof(MEMORY) + sizeof(HEAP) + 3 * alignof(std::max_align_t) };
+    static constexpr size_t GROW_SLACK{ 256 };
+
+    void* alloc_from_regions(size_t size)
+    {
+        for (size_t i{ 0 }; i < count; i++) {
+            if (auto* p{ regions[i].heap->alloc(size) }; p != nullptr) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    struct region
+    {
+        cbl::interval range;
+        HEAP* heap;
+    };
+
+    grow_fn grow_;
+
+    std::array<region, MAX_REGIONS> regions{};
+    size_t count{ 0 };
+};
@@ -0,0 +1,292 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/util/math.hpp>
+#include <toyos/util/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/**
+ * \brief Block manager that keeps its state in the managed memory
+ *
+ * The free blocks of every order form a doubly linked list whose nodes are
+ * stored in the first bytes of the free blocks themselves. A bitmap per order
+ * records which blocks are free, so finding out whether a buddy can be merged
+ * needs no search. The manager never allocates and all operations take
+ * constant time.
+ *
+ * The bitmaps are part of the object and cover a span of 2^SPAN_ORDER block
+ * ids starting at the base passed to the constructor. Block ids outside of
+ * the span cannot be managed.
+ *
+ * The ids are shifted left by ADDR_SHIFT to get the address of the memory
+ * they refer to, e.g. by PAGE_BITS for a buddy that manages page numbers.
+ * Free memory must be writable.
+ *
+ * \tparam SPAN_ORDER Order of the managed span in block ids.
+ * \tparam MIN_ORDER  Smallest block order that is ever used.
+ * \tparam ADDR_SHIFT Conversion from block ids to addresses.
+ */
+template<math::order_t SPAN_ORDER, math::order_t MIN_ORDER = 0, unsigned ADDR_SHIFT = 0>
+class intrusive_block_manager
+{
+    static_assert(MIN_ORDER <= SPAN_ORDER, "The span has to hold a block of minimal order");
+    static_assert(SPAN_ORDER < 64, "Bad span order");
+    static_assert(SPAN_ORDER - MIN_ORDER <= 24, "The bitmaps would be too large");
+
+    // Every order has room for one more block than fits into the span,
+    // because the span does not need to be aligned.
+    static constexpr size_t bits_for_order(math::order_t ord)
+    {
+        return (static_cast<size_t>(1) << (SPAN_ORDER - ord)) + 1;
+    }
+
+    static constexpr size_t total_bits()
+    {
+        size_t bits{ 0 };
+        for (auto ord{ MIN_ORDER }; ord <= SPAN_ORDER; ord++) {
+            bits += bits_for_order(ord);
+        }
+        return bits;
+    }
+
+ public:
+    /**
+     * Creates a manager without free blocks.
+     *
+     * \param max_ord_ The maximal order of a block. Larger orders than
+     *                 SPAN_ORDER are ignored.
+     * \param base     The first block id of the managed span.
+     */
+    intrusive_block_manager(math::order_t max_ord_, uintptr_t base)
+        : max_ord(std::min(max_ord_, SPAN_ORDER)), span_base(base)
+    {
+        ASSERT(max_ord >= MIN_ORDER, "Bad maximal order");
+
+        size_t offset{ 0 };
+        for (auto ord{ MIN_ORDER }; ord <= SPAN_ORDER; ord++) {
+            bitmap_offsets[ord] = offset;
+            offset += bits_for_order(ord);
+        }
+    }
+
+    struct free_block_id
+    {
+        math::order_t ord;
+        uintptr_t addr;
+
+        math::order_t get_ord() const
+        {
+            return ord;
+        }
+        uintptr_t get_addr() const
+        {
+            return addr;
+        }
+    };
+
+    /**
+     * Find a free block of order *at least* the provided one.
+     *
+     * \param order The order the free block should at least have.
+     * \return An optional block id, empty optional if unsuccessful.
+     */
+    std::optional<free_block_id> get_free(math::order_t order) const
+    {
+        if (order > max_ord) {
+            return {};
+        }
+
+        auto candidates{ non_empty_orders & ~math::mask(order) };
+        if (candidates == 0) {
+            return {};
+        }
+
+        auto ord{ static_cast<math::order_t>(__builtin_ctzll(candidates)) };
+        return { { ord, id_of(heads[ord]) } };
+    }
+
+    /**
+     * Splits a free block in two halves and returns the first half.
+     *
+     * \param block The block to split.
+     * \return The first half of the split block.
+     */
+    free_block_id split_free(const free_block_id& block)
+    {
+        math::order_t ord{ block.get_ord() };
+        uintptr_t addr{ block.get_addr() };
+        ASSERT(ord > MIN_ORDER, "cannot split block of minimal order");
+
+        trace(TRACE_BUDDY, "Splitting order {} free block at addr {#x}", ord, addr);
+
+        remove(addr, ord--);
+        insert(addr + (static_cast<uintptr_t>(1) << ord), ord);
+        insert(addr, ord);
+
+        return { ord, addr };
+    }
+
+    /**
+     * Merge a free block with its buddy, if possible.
+     *
+     * \param block The free block to merge.
+     * \return Block id of the resulting block, empty optional otherwise.
+     */
+    std::optional<free_block_id> merge_free(const free_block_id& block)
+    {
+        math::order_t ord{ block.get_ord() };
+        if (ord >= max_ord) {
+            return {};
+        }
+
+        uintptr_t addr{ block.get_addr() };
+        uintptr_t buddy_addr{ addr ^ (static_cast<uintptr_t>(1) << ord) };
+
+        if (not in_span(buddy_addr, ord) or not is_free(buddy_addr, ord)) {
+            return {};
+        }
+
+        remove(addr, ord);
+        remove(buddy_addr, ord);
+
+        // Only the first block of the merged one keeps a list node.
+        clear_node(std::max(addr, buddy_addr));
+
+        addr = std::min(addr, buddy_addr);
+        insert(addr, ++ord);
+
+        return { { ord, addr } };
+    }
+
+    /**
+     * Remove a free block.
+     *
+     * \param block The block to remove.
+     */
+    void mark_used(const free_block_id& block)
+    {
+        remove(block.get_addr(), block.get_ord());
+
+        // Don't hand out memory with stale list pointers.
+        clear_node(block.get_addr());
+    }
+
+    /**
+     * Add a free block (but don't do any merging).
+     *
+     * \param addr The address of the free block to add.
+     * \param order The order of the free block.
+     */
+    free_block_id add_free(const uintptr_t addr, const math::order_t ord)
+    {
+        ASSERT(ord <= max_ord, "Order {} too large, maximum {}", ord, max_ord);
+        ASSERT(ord >= MIN_ORDER, "Order {} too small, minimum {}", ord, MIN_ORDER);
+        ASSERT(math::is_aligned(addr, ord), "Address {#x} not aligned to order {}", addr, ord);
+        ASSERT(addr != 0, "Block 0 cannot be managed");
+        ASSERT(in_span(addr, ord), "Block at {#x} outside of the managed span", addr);
+        ASSERT(not is_free(addr, ord), "Block at {#x} is already free", addr);
+
+        insert(addr, ord);
+        return { ord, addr };
+    }
+
+ private:
+    static constexpr math::order_t maximal_order{ 63 };
+
+    struct free_node
+    {
+        free_node* prev;
+        free_node* next;
+    };
+
+    static free_node* node_of(uintptr_t addr)
+    {
+        return reinterpret_cast<free_node*>(addr << ADDR_SHIFT);
+    }
+
+    static uintptr_t id_of(const free_node* node)
+    {
+        return reinterpret_cast<uintptr_t>(node) >> ADDR_SHIFT;
+    }
+
+    static void clear_node(uintptr_t addr)
+    {
+        *node_of(addr) = {};
+    }
+
+    bool in_span(uintptr_t addr, math::order_t ord) const
+    {
+        auto span_end{ span_base + (static_cast<uintptr_t>(1) << SPAN_ORDER) };
+        return ord <= SPAN_ORDER and addr >= span_base and addr + (static_cast<uintptr_t>(1) << ord) <= span_end;
+    }
+
+    size_t bit_index(uintptr_t addr, math::order_t ord) const
+    {
+        return bitmap_offsets[ord] + ((addr >> ord) - (span_base >> ord));
+    }
+
+    bool is_free(uintptr_t addr, math::order_t ord) const
+    {
+        auto bit{ bit_index(addr, ord) };
+        return bitmap[bit / 64] & (uint64_t(1) << (bit % 64));
+    }
+
+    void set_free(uintptr_t addr, math::order_t ord, bool free)
+    {
+        auto bit{ bit_index(addr, ord) };
+        auto mask{ uint64_t(1) << (bit % 64) };
+        bitmap[bit / 64] = free ? bitmap[bit / 64] | mask : bitmap[bit / 64] & ~mask;
+    }
+
+    void insert(uintptr_t addr, math::order_t ord)
+    {
+        auto* node{ node_of(addr) };
+        *node = { nullptr, heads[ord] };
+
+        if (heads[ord] != nullptr) {
+            heads[ord]->prev = node;
+        }
+        heads[ord] = node;
+
+        non_empty_orders |= uint64_t(1) << ord;
+        set_free(addr, ord, true);
+    }
+
+    void remove(uintptr_t addr, math::order_t ord)
+    {
+        auto* node{ node_of(addr) };
+
+        if (node->prev != nullptr) {
+            node->prev->next = node->next;
+        }
+        else {
+            heads[ord] = node->next;
+        }
+        if (node->next != nullptr) {
+            node->next->prev = node->prev;
+        }
+
+        if (heads[ord] == nullptr) {
+            non_empty_orders &= ~(uint64_t(1) << ord);
+        }
+        set_free(addr, ord, false);
+    }
+
+    math::order_t max_ord;
+    uintptr_t span_base;
+
+    std::array<free_node*, maximal_order + 1> heads{};
+
+    // Bit i is set if the list of order i is not empty.
+    uint64_t non_empty_orders{ 0 };
+
+    std::array<size_t, SPAN_ORDER + 1> bitmap_offsets{};
+    std::array<uint64_t, total_bits() / 64 + 1> bitmap{};
+};
@@ -0,0 +1,272 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/multiboot/multiboot.hpp>
+#include <toyos/multiboot2/multiboot2.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/interval.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/xen-pvh.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+/**
+ * The type of a physical memory region.
+ *
+ * All supported boot protocols use the address range types of the ACPI
+ * specification. Unknown types are kept as they are.
+ */
+enum class memory_type : uint32_t
+{
+    USABLE = 1,
+    RESERVED = 2,
+    ACPI_RECLAIMABLE = 3,
+    ACPI_NVS = 4,
+    UNUSABLE = 5,
+};
+
+struct memory_region
+{
+    cbl::interval range;
+    memory_type type;
+};
+
+/**
+ * \brief The physical memory map of the machine
+ *
+ * The regions are sorted by their base address. The map has a fixed capacity
+ * and never allocates, so it can be built before the heap has memory. It is
+ * too large for the boot stack and is meant to live in static storage.
+ */
+class memory_map
+{
+ public:
+    static constexpr size_t MAX_REGIONS{ 128 };
+
+    /**
+     * Adds a region. Empty regions are ignored.
+     *
+     * Adjacent and overlapping regions of the same type are merged. If the
+     * map is full nonetheless, a region is dropped with a warning. See
+     * drop_one() for which one.
+     */
+    void add(const cbl::interval& range, memory_type type)
+    {
+        if (range.empty()) {
+            return;
+        }
+
+        // Firmware often splits memory into many adjacent regions.
+        memory_region added{ range, type };
+        for (size_t i{ 0 }; i < count;) {
+            const auto& r{ regions[i] };
+            if (r.type != type or r.range.b < added.range.a or added.range.b < r.range.a) {
+                i++;
+                continue;
+            }
+
+            added.range = { std::min(added.range.a, r.range.a), std::max(added.range.b, r.range.b) };
+            erase(i);
+        }
+
+        if (count == MAX_REGIONS and not drop_one(added)) {
+            return;
+        }
+
+        auto* first{ regions.data() };
+        auto* last{ first + count };
+        auto* pos{ std::upper_bound(first, last, added.range.a, [](uint64_t a, const memory_region& r) { return a < r.range.a; }) };
+        std::move_backward(pos, last, last + 1);
+        *pos = added;
+        count++;
+    }
+
+    /// Removes the given range from all usable regions.
+    void reserve(cbl::interval range)
+    {
+        // The parts that are left over never intersect the range again. Adding
+        // them to a full map may drop any region, though, so start over.
+        for (size_t i{ 0 }; i < count;) {
+            auto r{ regions[i] };
+            if (r.type != memory_type::USABLE or not r.range.intersects(range)) {
+                i++;
+                continue;
+            }
+
+            erase(i);
+            add({ r.range.a, std::min(r.range.b, range.a) }, r.type);
+            add({ std::max(r.range.a, range.b), r.range.b }, r.type);
+            i = 0;
+        }
+    }
+
+    /// Returns the number of bytes in usable regions.
+    uint64_t usable_bytes() const
+    {
+        uint64_t bytes{ 0 };
+        for (const auto& r : *this) {
+            bytes += r.type == memory_type::USABLE ? r.range.size() : 0;
+        }
+        return bytes;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+    size_t size() const
+    {
+        return count;
+    }
+
+    const memory_region* begin() const
+    {
+        return regions.data();
+    }
+    const memory_region* end() const
+    {
+        return regions.data() + count;
+    }
+
+    /**
+     * Adds the memory map of a Multiboot1 information structure.
+     *
+     * Without a memory map, the upper memory size is used instead.
+     */
+    void add_multiboot1(const multiboot::multiboot_info& mbi)
+    {
+        if (mbi.has_mmap()) {
+            add_multiboot1_entries(num_to_ptr<const uint8_t>(mbi.mmap_addr), mbi.mmap_length);
+        }
+        else if (mbi.has_mem()) {
+            static constexpr uint64_t UPPER_MEMORY_BASE{ 0x100000 };
+            add(cbl::interval::from_size(UPPER_MEMORY_BASE, uint64_t(mbi.mem_upper) * 1024), memory_type::USABLE);
+        }
+    }
+
+    /// Adds the entries of a Multiboot1 memory map buffer.
+    void add_multiboot1_entries(const uint8_t* buffer, size_t length)
+    {
+        multiboot::multiboot_mmap_entry entry;
+
+        for (size_t offset{ 0 }; offset + sizeof(entry) <= length; offset += entry.size + sizeof(entry.size)) {
+            memcpy(&entry, buffer + offset, sizeof(entry));
+            add(cbl::interval::from_size(entry.base_addr, entry.length), memory_type(entry.type));
+        }
+
+        reserve_unusable();
+    }
+
+    /// Adds the memory map tag of a Multiboot2 information structure.
+    void add_multiboot2(const multiboot2::mbi2_reader& reader)
+    {
+        const auto tag{ reader.find_tag(multiboot2::mbi2_mmap::TYPE) };
+        if (not tag) {
+            return;
+        }
+
+        const auto mmap{ tag->get_full_tag<multiboot2::mbi2_mmap>() };
+        PANIC_UNLESS(mmap.entry_size >= sizeof(multiboot2::mmap_entry), "Malformed memory map tag");
+
+        for (auto offset{ sizeof(mmap) }; offset + sizeof(multiboot2::mmap_entry) <= tag->generic.size; offset += mmap.entry_size) {
+            multiboot2::mmap_entry entry;
+            memcpy(&entry, tag->addr + offset, sizeof(entry));
+            add(cbl::interval::from_size(entry.base, entry.length), memory_type(entry.type));
+        }
+
+        reserve_unusable();
+    }
+
+    /// Adds the memory map of a Xen PVH start info structure.
+    void add_xen_pvh(const xen_pvh::hvm_start_info& info)
+    {
+        // The memory map fields only exist since version 1.
+        if (info.version < 1) {
+            return;
+        }
+
+        const auto* entries{ num_to_ptr<const xen_pvh::hvm_memmap_table_entry>(info.memmap_paddr) };
+        for (uint32_t i{ 0 }; i < info.memmap_entries; i++) {
+            add(cbl::interval::from_size(entries[i].addr, entries[i].size), memory_type(entries[i].type));
+        }
+
+        reserve_unusable();
+    }
+
+ private:
+    void erase(size_t i)
+    {
+        std::move(regions.begin() + i + 1, regions.begin() + count, regions.begin() + i);
+        count--;
+    }
+
+    /**
+     * Makes room in a full map for the given region.
+     *
+     * Usable regions are kept as long as possible. The first choice is the
+     * smallest non-usable region that doesn't overlap usable memory, because
+     * it doesn't change which memory is usable. Otherwise, the smallest usable
+     * region goes. Returns false if that is the given region itself.
+     */
+    bool drop_one(const memory_region& added)
+    {
+        auto overlaps_usable = [this, &added](const memory_region& r) {
+            return (added.type == memory_type::USABLE and added.range.intersects(r.range))
+                   or std::any_of(begin(), end(), [&r](const memory_region& u) {
+                          return u.type == memory_type::USABLE and u.range.intersects(r.range);
+                      });
+        };
+        auto droppable = [&overlaps_usable](const memory_region& r) {
+            return r.type == memory_type::USABLE or not overlaps_usable(r);
+        };
+        // Orders regions by how much we want to keep them.
+        auto keep_rank = [](const memory_region& r) {
+            return std::pair(r.type == memory_type::USABLE, r.range.size());
+        };
+
+        const memory_region* victim{ droppable(added) ? &added : nullptr };
+        for (const auto& r : *this) {
+            if (droppable(r) and (victim == nullptr or keep_rank(r) < keep_rank(*victim))) {
+                victim = &r;
+            }
+        }
+
+        // A non-usable region can only overlap usable memory if there is a
+        // usable region, which we can drop. So there always is a victim.
+        warning("Memory map is full, dropping {#x}-{#x} (type {})", victim->range.a, victim->range.b, static_cast<uint32_t>(victim->type));
+
+        if (victim == &added) {
+            return false;
+        }
+
+        erase(static_cast<size_t>(victim - begin()));
+        return true;
+    }
+
+    /// Firmware may report overlapping regions. Reserved memory takes precedence.
+    void reserve_unusable()
+    {
+        // A full map drops regions while reserving, so look for the next
+        // overlap from the start every time.
+        while (true) {
+            auto it{ std::find_if(begin(), end(), [this](const memory_region& r) {
+                return r.type != memory_type::USABLE and std::any_of(begin(), end(), [&r](const memory_region& u) {
+                           return u.type == memory_type::USABLE and u.range.intersects(r.range);
+                       });
+            }) };
+            if (it == end()) {
+                return;
+            }
+            reserve(it->range);
+        }
+    }
+
+    std::array<memory_region, MAX_REGIONS> regions{};
+    size_t count{ 0 };
+};
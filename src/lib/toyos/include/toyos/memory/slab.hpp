@@ -0,0 +1,212 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <arch.h>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/math.hpp>
+#include <toyos/util/trace.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * \brief A cache of equally sized objects
+ *
+ * The cache takes whole pages from a page source and cuts them into objects
+ * of its size. Free objects form a singly linked list that is stored in the
+ * objects themselves, so allocation and deallocation take constant time.
+ *
+ * Every page starts with a header that points back to its cache, so the cache
+ * of an object can be found from its address alone. Pages are never returned
+ * to the page source.
+ */
+class slab_cache
+{
+ public:
+    /// Returns a page-aligned page or nullptr if there is no memory left.
+    using page_alloc_fn = void* (*)();
+
+    /// Objects are aligned like memory from the regular heap.
+    static constexpr size_t OBJECT_ALIGNMENT{ 16 };
+
+    struct statistics
+    {
+        size_t allocations;
+        size_t frees;
+        size_t objects_in_use;
+        size_t pages;
+
+        // Allocations that failed, because the page source was empty
+        size_t failed_allocations;
+    };
+
+    /**
+     * Creates a cache without pages.
+     *
+     * \param object_size The size of the objects. It is rounded up to the
+     *                    object alignment.
+     * \param alloc_page  The source of fresh pages.
+     */
+    slab_cache(size_t object_size, page_alloc_fn alloc_page)
+        : object_size_(math::align_up(object_size, math::order_max(OBJECT_ALIGNMENT))), alloc_page_(alloc_page)
+    {
+        ASSERT(object_size_ >= sizeof(free_object), "Objects too small for the free list");
+        ASSERT(object_size_ <= PAGE_SIZE - HEADER_SIZE, "Objects too large for a slab page");
+    }
+
+    /// Returns a free object or nullptr if the page source is empty.
+    void* alloc()
+    {
+        if (free_list == nullptr and not refill()) {
+            stats_.failed_allocations++;
+            return nullptr;
+        }
+
+        auto* obj{ free_list };
+        free_list = obj->next;
+
+        stats_.allocations++;
+        stats_.objects_in_use++;
+        return obj;
+    }
+
+    /// Returns an object to the cache it was allocated from.
+    void free(void* p)
+    {
+        ASSERT(&owner(p) == this, "Object {} belongs to a different cache", p);
+
+        auto* obj{ static_cast<free_object*>(p) };
+        obj->next = free_list;
+        free_list = obj;
+
+        stats_.frees++;
+        stats_.objects_in_use--;
+    }
+
+    /// Returns the cache an object was allocated from.
+    static slab_cache& owner(const void* p)
+    {
+        auto page{ math::align_down(ptr_to_num(p), PAGE_BITS) };
+        return *num_to_ptr<page_header>(page)->cache;
+    }
+
+    size_t object_size() const
+    {
+        return object_size_;
+    }
+
+    const statistics& stats() const
+    {
+        return stats_;
+    }
+
+ private:
+    struct free_object
+    {
+        free_object* next;
+    };
+
+    struct page_header
+    {
+        slab_cache* cache;
+    };
+
+    static constexpr size_t HEADER_SIZE{ math::align_up(sizeof(page_header), math::order_max(OBJECT_ALIGNMENT)) };
+
+    /// Cuts a fresh page into objects.
+    bool refill()
+    {
+        auto* page{ alloc_page_() };
+        if (page == nullptr) {
+            return false;
+        }
+
+        ASSERT(math::is_aligned(ptr_to_num(page), PAGE_BITS), "Slab page {} is not aligned", page);
+        num_to_ptr<page_header>(ptr_to_num(page))->cache = this;
+
+        // Link the objects in address order, which is the order they are
+        // handed out.
+        auto first{ ptr_to_num(page) + HEADER_SIZE };
+        auto count{ (PAGE_SIZE - HEADER_SIZE) / object_size_ };
+        for (size_t i{ count }; i > 0; i--) {
+            auto* obj{ num_to_ptr<free_object>(first + (i - 1) * object_size_) };
+            obj->next = free_list;
+            free_list = obj;
+        }
+
+        stats_.pages++;
+        return true;
+    }
+
+    size_t object_size_;
+    page_alloc_fn alloc_page_;
+
+    free_object* free_list{ nullptr };
+    statistics stats_{};
+};
+
+/**
+ * \brief Slab caches for a range of small object sizes
+ *
+ * Allocations are served by the cache of the smallest size class that fits.
+ */
+class slab_allocator
+{
+ public:
+    // With the page header, a page holds only three 1 KiB objects and wastes
+    // a quarter of its space, so larger objects are left to the heap.
+    static constexpr std::array<size_t, 6> SIZE_CLASSES{ 16, 32, 64, 128, 256, 512 };
+
+    /// The largest allocation the slab caches serve.
+    static constexpr size_t MAX_SIZE{ SIZE_CLASSES.back() };
+
+    explicit slab_allocator(slab_cache::page_alloc_fn alloc_page)
+        : caches_(make_caches(alloc_page, std::make_index_sequence<SIZE_CLASSES.size()>{}))
+    {}
+
+    /**
+     * Allocates an object of at least the given size.
+     *
+     * \return The object or nullptr if the size is too large or the page
+     *         source is empty.
+     */
+    void* alloc(size_t size)
+    {
+        if (size > MAX_SIZE) {
+            return nullptr;
+        }
+        return caches_[size_class(size)].alloc();
+    }
+
+    /// Frees an object that was allocated from any slab cache.
+    static void free(void* p)
+    {
+        slab_cache::owner(p).free(p);
+    }
+
+    const std::array<slab_cache, SIZE_CLASSES.size()>& caches() const
+    {
+        return caches_;
+    }
+
+ private:
+    static size_t size_class(size_t size)
+    {
+        if (size <= SIZE_CLASSES.front()) {
+            return 0;
+        }
+        return math::order_envelope(size) - math::order_max(SIZE_CLASSES.front());
+    }
+
+    template<size_t... I>
+    static std::array<slab_cache, SIZE_CLASSES.size()> make_caches(slab_cache::page_alloc_fn alloc_page, std::index_sequence<I...>)
+    {
+        return { { slab_cache(SIZE_CLASSES[I], alloc_page)... } };
+    }
+
+    std::array<slab_cache, SIZE_CLASSES.size()> caches_;
+};
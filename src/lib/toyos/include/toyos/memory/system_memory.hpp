@@ -0,0 +1,42 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/memory/memory_map.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/math.hpp>
+#include <toyos/x86/arch.hpp>
+
+#include <cstdint>
+#include <optional>
+
+/**
+ * Physical memory below this address is identity mapped by the boot page
+ * tables. Only RAM below it is handed out.
+ */
+static constexpr uint64_t IDENTITY_MAPPED_LIMIT{ 4_GiB };
+
+/**
+ * The physical memory map that the boot loader passed. It is empty if the
+ * boot loader did not pass one.
+ */
+const memory_map& boot_memory_map();
+
+/**
+ * Allocates naturally aligned, contiguous physical memory.
+ *
+ * The memory comes from the usable RAM outside of the image and is identity
+ * mapped. The heap grows from the same memory.
+ *
+ * \param order The order of the size in bytes, at least PAGE_BITS.
+ * \return The address of the memory or an empty optional if no block of the
+ *         requested size is free.
+ */
+std::optional<phy_addr_t> alloc_phys(math::order_t order);
+
+/// Returns memory that was allocated with alloc_phys().
+void free_phys(phy_addr_t addr, math::order_t order);
+
+/// Returns the number of bytes that alloc_phys() has left.
+uint64_t free_phys_bytes();
@@ -0,0 +1,321 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/util/math.hpp>
+#include <toyos/util/trace.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Two-level segregated fit heap
+ *
+ * Free blocks are kept in segregated lists. The first level divides the sizes
+ * into powers of two, the second level divides every power of two linearly
+ * into SL_COUNT ranges. A bitmap per level records which lists are not empty,
+ * so finding a fitting block takes two bit scans. Neighboring free blocks are
+ * merged right away, so alloc() and free() take bounded, constant time
+ * regardless of fragmentation.
+ *
+ * The interface matches first_fit_heap, so both can be used interchangeably.
+ *
+ * Reference: M. Masmano et al., "TLSF: a New Dynamic Memory Allocator for
+ *            Real-Time Systems", ECRTS 2004
+ */
+template<size_t ALIGNMENT = 16>
+class tlsf_heap
+{
+    static_assert(ALIGNMENT == 16, "The block header is laid out for an alignment of 16");
+
+    static constexpr unsigned ALIGN_LOG2{ 4 };
+    static constexpr unsigned SL_LOG2{ 4 };
+    static constexpr unsigned SL_COUNT{ 1u << SL_LOG2 };
+
+    // Sizes below SMALL_BLOCK_SIZE are kept in the linearly divided first list.
+    static constexpr unsigned FL_SHIFT{ SL_LOG2 + ALIGN_LOG2 };
+    static constexpr size_t SMALL_BLOCK_SIZE{ size_t(1) << FL_SHIFT };
+
+    // Blocks have to be smaller than 4 GiB.
+    static constexpr unsigned FL_MAX_LOG2{ 32 };
+    static constexpr unsigned FL_COUNT{ FL_MAX_LOG2 - FL_SHIFT + 1 };
+
+ public:
+    /// Creates a heap in the given memory, which has to provide base() and size().
+    template<class MEMORY>
+    explicit tlsf_heap(const MEMORY& mem)
+        : tlsf_heap(mem.base(), mem.size())
+    {}
+
+    tlsf_heap(uintptr_t base, size_t size)
+    {
+        add_region(base, size);
+    }
+
+    /// Returns memory of at least the given size or nullptr if none is left.
+    void* alloc(size_t size)
+    {
+        size = std::max(math::align_up(size, ALIGN_LOG2), MIN_PAYLOAD);
+        if (size >= MAX_PAYLOAD) {
+            return nullptr;
+        }
+
+        auto* b{ find_free(size) };
+        if (b == nullptr) {
+            return nullptr;
+        }
+
+        remove_free(b);
+        split(b, size);
+        b->set_free(false);
+
+        free_bytes -= b->size();
+        return b->payload();
+    }
+
+    /// Returns memory to the heap. Pointers that do not belong to the heap are ignored.
+    void free(void* p)
+    {
+        auto addr{ reinterpret_cast<uintptr_t>(p) };
+        if (p == nullptr or addr < region_begin or addr >= region_end) {
+            return;
+        }
+
+        auto* b{ block::from_payload(p) };
+        ASSERT(not b->is_free(), "Double free of {}", p);
+
+        free_bytes += b->size();
+        b->set_free(true);
+
+        if (auto* prev{ b->prev_phys }; prev != nullptr and prev->is_free()) {
+            remove_free(prev);
+            absorb_next(prev);
+            b = prev;
+        }
+
+        if (auto* next{ b->next_phys() }; next->is_free()) {
+            remove_free(next);
+            absorb_next(b);
+        }
+
+        insert_free(b);
+    }
+
+    /// Returns the number of free payload bytes.
+    size_t free_mem() const
+    {
+        return free_bytes;
+    }
+
+    constexpr size_t alignment() const
+    {
+        return ALIGNMENT;
+    }
+
+ private:
+    struct block
+    {
+        static constexpr size_t FREE_BIT{ 1 };
+
+        // The physically preceding block or nullptr for the first one
+        block* prev_phys;
+        size_t size_and_flags;
+
+        // Only valid while the block is free
+        block* next_free;
+        block* prev_free;
+
+        size_t size() const
+        {
+            return size_and_flags & ~FREE_BIT;
+        }
+        void set_size(size_t size)
+        {
+            size_and_flags = size | (size_and_flags & FREE_BIT);
+        }
+
+        bool is_free() const
+        {
+            return size_and_flags & FREE_BIT;
+        }
+        void set_free(bool free)
+        {
+            size_and_flags = free ? size_and_flags | FREE_BIT : size_and_flags & ~FREE_BIT;
+        }
+
+        void* payload()
+        {
+            return reinterpret_cast<char*>(this) + HEADER_SIZE;
+        }
+        static block* from_payload(void* p)
+        {
+            return reinterpret_cast<block*>(static_cast<char*>(p) - HEADER_SIZE);
+        }
+
+        block* next_phys()
+        {
+            return reinterpret_cast<block*>(static_cast<char*>(payload()) + size());
+        }
+    };
+
+    // Used blocks only keep the fields before the free list pointers.
+    static constexpr size_t HEADER_SIZE{ 2 * sizeof(size_t) };
+    static constexpr size_t MIN_PAYLOAD{ sizeof(block) - HEADER_SIZE };
+    static constexpr size_t MAX_PAYLOAD{ size_t(1) << FL_MAX_LOG2 };
+
+    struct list_index
+    {
+        unsigned fl;
+        unsigned sl;
+    };
+
+    static unsigned highest_bit(size_t v)
+    {
+        return 63 - static_cast<unsigned>(__builtin_clzll(v));
+    }
+
+    /// Returns the list a free block of the given size belongs to.
+    static list_index mapping_insert(size_t size)
+    {
+        if (size < SMALL_BLOCK_SIZE) {
+            return { 0, static_cast<unsigned>(size >> ALIGN_LOG2) };
+        }
+
+        auto fl{ highest_bit(size) };
+        auto sl{ static_cast<unsigned>(size >> (fl - SL_LOG2)) ^ SL_COUNT };
+        return { fl - FL_SHIFT + 1, sl };
+    }
+
+    /// Returns the first list whose blocks all fit the given size.
+    static list_index mapping_search(size_t size)
+    {
+        if (size >= SMALL_BLOCK_SIZE) {
+            size += (size_t(1) << (highest_bit(size) - SL_LOG2)) - 1;
+        }
+        return mapping_insert(size);
+    }
+
+    block* find_free(size_t size) const
+    {
+        auto idx{ mapping_search(size) };
+        if (idx.fl >= FL_COUNT) {
+            return nullptr;
+        }
+
+        uint32_t sl_map{ sl_bitmap[idx.fl] & (~0u << idx.sl) };
+        if (sl_map == 0) {
+            uint32_t fl_map{ idx.fl + 1 < FL_COUNT ? fl_bitmap & (~0u << (idx.fl + 1)) : 0 };
+            if (fl_map == 0) {
+                return nullptr;
+            }
+
+            idx.fl = static_cast<unsigned>(__builtin_ctz(fl_map));
+            sl_map = sl_bitmap[idx.fl];
+        }
+
+        idx.sl = static_cast<unsigned>(__builtin_ctz(sl_map));
+        return heads[idx.fl][idx.sl];
+    }
+
+    void insert_free(block* b)
+    {
+        auto idx{ mapping_insert(b->size()) };
+        auto*& head{ heads[idx.fl][idx.sl] };
+
+        b->prev_free = nullptr;
+        b->next_free = head;
+        if (head != nullptr) {
+            head->prev_free = b;
+        }
+        head = b;
+
+        fl_bitmap |= 1u << idx.fl;
+        sl_bitmap[idx.fl] |= 1u << idx.sl;
+    }
+
+    void remove_free(block* b)
+    {
+        auto idx{ mapping_insert(b->size()) };
+        auto*& head{ heads[idx.fl][idx.sl] };
+
+        if (b->prev_free != nullptr) {
+            b->prev_free->next_free = b->next_free;
+        }
+        else {
+            head = b->next_free;
+        }
+        if (b->next_free != nullptr) {
+            b->next_free->prev_free = b->prev_free;
+        }
+
+        if (head == nullptr) {
+            sl_bitmap[idx.fl] &= ~(1u << idx.sl);
+            if (sl_bitmap[idx.fl] == 0) {
+                fl_bitmap &= ~(1u << idx.fl);
+            }
+        }
+    }
+
+    /// Cuts off the part of a block that is not needed and puts it on a free list.
+    void split(block* b, size_t size)
+    {
+        if (b->size() < size + HEADER_SIZE + MIN_PAYLOAD) {
+            return;
+        }
+
+        auto* rest{ reinterpret_cast<block*>(static_cast<char*>(b->payload()) + size) };
+        rest->prev_phys = b;
+        rest->size_and_flags = (b->size() - size - HEADER_SIZE) | block::FREE_BIT;
+        rest->next_phys()->prev_phys = rest;
+
+        b->set_size(size);
+        free_bytes -= HEADER_SIZE;
+
+        insert_free(rest);
+    }
+
+    /// Merges the physically next block into b. Both have to be off the free lists.
+    void absorb_next(block* b)
+    {
+        auto* next{ b->next_phys() };
+        b->set_size(b->size() + HEADER_SIZE + next->size());
+        b->next_phys()->prev_phys = b;
+        free_bytes += HEADER_SIZE;
+    }
+
+    void add_region(uintptr_t base, size_t size)
+    {
+        auto begin{ math::align_up(base, ALIGN_LOG2) };
+        auto end{ math::align_down(base + size, ALIGN_LOG2) };
+        ASSERT(end > begin and end - begin >= 2 * HEADER_SIZE + MIN_PAYLOAD, "Heap region too small");
+        ASSERT(end - begin - 2 * HEADER_SIZE < MAX_PAYLOAD, "Heap region too large");
+
+        region_begin = begin;
+        region_end = end;
+
+        // The region ends with an empty used block, so every real block has a
+        // physical successor and is never merged beyond the region.
+        auto* b{ reinterpret_cast<block*>(begin) };
+        b->prev_phys = nullptr;
+        b->size_and_flags = (end - begin - 2 * HEADER_SIZE) | block::FREE_BIT;
+
+        auto* sentinel{ b->next_phys() };
+        sentinel->prev_phys = b;
+        sentinel->size_and_flags = 0;
+
+        free_bytes += b->size();
+        insert_free(b);
+    }
+
+    uint32_t fl_bitmap{ 0 };
+    std::array<uint32_t, FL_COUNT> sl_bitmap{};
+    std::array<std::array<block*, SL_COUNT>, FL_COUNT> heads{};
+
+    uintptr_t region_begin{ 0 };
+    uintptr_t region_end{ 0 };
+
+    size_t free_bytes{ 0 };
+};
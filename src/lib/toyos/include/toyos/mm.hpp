@@ -7,6 +7,7 @@
 #include "pdpt.hpp"
 #include "pml4.hpp"
 #include "pt.hpp"
+#include "toyos/util/literals.hpp"
 #include "toyos/util/math.hpp"
 #include <toyos/x86/arch.hpp>
 
@@ -43,6 +44,21 @@ class memory_manager
     };
 
  public:
+    // The attributes of the pages that map_range() creates
+    struct mapping_attributes
+    {
+        bool writeable{ true };
+        bool usermode{ true };
+        bool pwt{ false };
+        bool pcd{ false };
+        bool pat{ false };
+        bool global{ false };
+        bool exec_disable{ false };
+
+        // The largest page that may be used, e.g. PAGE_BITS to map with 4 KiB pages only
+        math::order_t max_page_order{ math::order_max(1_GiB) };
+    };
+
     // Write the address of the given pml4 into the cr3-register
     static void set_pml4(PML4& pml4);
 
@@ -68,7 +84,26 @@ class memory_manager
     static phy_addr_t lin_to_phys(lin_addr_t lin_addr);
     static lin_addr_t phy_to_lin(phy_addr_t phy_addr);
 
+    /* Maps the linear range [lin, lin + size) to the physical range starting at phys in the
+     * current page tables. All three values have to be page aligned.
+     *
+     * Every part of the range is mapped with the largest page that fits its alignment and
+     * attrs.max_page_order, 1 GiB pages only if the CPU supports them. Missing paging
+     * structures are allocated with alloc_phys(). Large pages that are only partly remapped
+     * are split up first.
+     *
+     * The TLB of the calling CPU is invalidated once at the end, either page by page or
+     * completely if too many translations changed. Other CPUs are not notified.
+     */
+    static void map_range(lin_addr_t lin, phy_addr_t phys, size_t size, const mapping_attributes& attrs);
+
  private:
+    class tlb_batch;
+
+    static PDPT& pdpt_for_mapping(lin_addr_t lin_addr, tlb_batch& batch);
+    static PD& pd_for_mapping(PDPTE& pdpte);
+    static PT& pt_for_mapping(PDE& pde);
+
     // The offset of a given address in the chosen paging structure
     static uint64_t pml4_offset(lin_addr_t lin_addr);
     static uint64_t pdpt_offset(lin_addr_t lin_addr);
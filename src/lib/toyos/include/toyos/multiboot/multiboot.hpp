@@ -26,6 +26,7 @@ namespace multiboot
             MEM = 1u << 0,
             DISK = 1u << 1,
             CMDLINE = 1u << 2,
+            MMAP = 1u << 6,
         };
 
         uint32_t flags;  ///< Indicates the presence of fields in the structure.
@@ -37,6 +38,19 @@ namespace multiboot
 
         uint32_t cmdline;  ///< Pointer to C-style cmdline string in physical memory. Valid if flags[2] is set.
 
+        uint32_t mods_count;  ///< Number of boot modules. Valid if flags[3] is set.
+        uint32_t mods_addr;   ///< Pointer to the first module structure. Valid if flags[3] is set.
+
+        uint32_t syms[4];  ///< Symbol table information. Valid if flags[4] or flags[5] is set.
+
+        uint32_t mmap_length;  ///< Size of the memory map buffer in bytes. Valid if flags[6] is set.
+        uint32_t mmap_addr;    ///< Pointer to the memory map buffer in physical memory. Valid if flags[6] is set.
+
+        bool has_mem() const
+        {
+            return flags & uint32_t(flag::MEM);
+        }  ///< Returns true iff mem_lower and mem_upper are valid.
+
         bool has_cmdline() const
         {
             return flags & uint32_t(flag::CMDLINE);
@@ -51,9 +65,29 @@ namespace multiboot
             return { reinterpret_cast<const char*>(cmdline) };
         }
 
+        bool has_mmap() const
+        {
+            return flags & uint32_t(flag::MMAP);
+        }  ///< Returns true iff mmap_length and mmap_addr are valid.
+
         // The rest of the structure is currently unused.
     };
 
+    /**
+ * Memory Map Entry
+ *
+ * The size field does not count itself, so the next entry starts size + 4
+ * bytes after the current one.
+ */
+    struct multiboot_mmap_entry
+    {
+        uint32_t size;
+        uint64_t base_addr;
+        uint64_t length;
+        uint32_t type;
+    };
+    static_assert(sizeof(multiboot_mmap_entry) == 24, "Wrong structure size!");
+
     struct multiboot_module
     {
         enum
@@ -8,19 +8,46 @@
 #include "toyos/util/math.hpp"
 #include "x86/arch.hpp"
 
-/* This pool always allocates 4k Bytes of memory.
+#include <utility>
+
+/* This pool allocates 4k Bytes of memory.
+ *
+ * With a MAX_ORDER above PAGE_BITS, free pages are merged and the pool can
+ * also hand out larger contiguous blocks.
  */
 
-class page_pool
+template<class block_manager = heap_block_manager, math::order_t MAX_ORDER = PAGE_BITS>
+class page_pool_impl
 {
+    static_assert(MAX_ORDER >= PAGE_BITS, "The pool has to hold whole pages");
+
  public:
+    /* Arguments are passed to the block manager.
+     */
+    template<typename... ARGS>
+    explicit page_pool_impl(ARGS&&... block_manager_args)
+        : bud(MAX_ORDER, std::forward<ARGS>(block_manager_args)...)
+    {}
+
     /* Allocs 4k Bytes of memory, aligned to 4k.
      * Panics if there is no free memory.
      */
     phy_addr_t alloc()
     {
-        std::optional<uintptr_t> addr = bud.alloc(PAGE_BITS);
+        auto addr{ try_alloc() };
         PANIC_UNLESS(addr, "Page pool got no address, we are out of memory!");
+        return *addr;
+    }
+
+    /* Allocs 4k Bytes of memory, aligned to 4k.
+     * Returns an empty optional if there is no free memory.
+     */
+    std::optional<phy_addr_t> try_alloc()
+    {
+        std::optional<uintptr_t> addr = bud.alloc(PAGE_BITS);
+        if (not addr) {
+            return {};
+        }
         return phy_addr_t(*addr);
     }
 
@@ -29,6 +56,39 @@ class page_pool
         bud.free(uintptr_t(addr), PAGE_BITS);
     }
 
+    /* Allocs 2^order Bytes of contiguous memory, naturally aligned.
+     * Returns an empty optional if there is no free block of that size.
+     */
+    std::optional<phy_addr_t> try_alloc_order(math::order_t order)
+    {
+        if (order < PAGE_BITS or order > MAX_ORDER) {
+            return {};
+        }
+
+        std::optional<uintptr_t> addr = bud.alloc(order);
+        if (not addr) {
+            return {};
+        }
+        return phy_addr_t(*addr);
+    }
+
+    void free_order(phy_addr_t addr, math::order_t order)
+    {
+        bud.free(uintptr_t(addr), order);
+    }
+
+    /* Adds all whole pages of the range to the pool.
+     */
+    void add_range(const cbl::interval& ival)
+    {
+        cbl::interval pages{ math::align_up(ival.a, PAGE_BITS), math::align_down(ival.b, PAGE_BITS) };
+        if (not pages.empty()) {
+            buddy_reclaim_range(pages, bud);
+        }
+    }
+
  private:
-    buddy bud{ PAGE_BITS };
+    buddy_impl<block_manager> bud;
 };
+
+using page_pool = page_pool_impl<>;
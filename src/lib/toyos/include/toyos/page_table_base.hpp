@@ -142,7 +142,8 @@ struct paging_structure_container
 {
     paging_structure_container() = default;
 
-    static paging_structure_container& alloc(page_pool& pool)
+    template<class POOL>
+    static paging_structure_container& alloc(POOL& pool)
     {
         return *(new (num_to_ptr<void>(pool.alloc())) paging_structure_container);
     }
@@ -0,0 +1,24 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+/*
+ * Support for getting a panic message out.
+ *
+ * A CPU may panic while it holds a lock that the output path needs, e.g.
+ * when an assertion fails within the heap or a printf backend. Once a panic
+ * started, such locks are only tried for a bounded time and bypassed
+ * afterwards, because a garbled message is better than none.
+ */
+
+/**
+ * Marks that a panic started. Called before the panic message is printed.
+ *
+ * Output that is captured by the memory console is written to the real
+ * consoles, which then also get the panic message.
+ */
+void begin_panic_output();
+
+/// Returns true once any CPU started to panic.
+bool panic_in_progress();
@@ -43,6 +43,12 @@ class pci_device
         DEV_TYPE = math::mask(7),
     };
 
+    enum command_bits : uint16_t
+    {
+        COMMAND_MEMORY_SPACE = 1u << 1,
+        COMMAND_BUS_MASTER = 1u << 2,
+    };
+
  public:
     using bdf_t = pci::bdf_t;  ///< Alias to the BDF structure.
 
@@ -50,6 +56,7 @@ class pci_device
     enum class offset
     {
         DEVICE_VENDOR_ID = 0x00,  ///< Device and Vendor identifier.
+        COMMAND = 0x04,           ///< Command register (lower half).
         CLASS = 0x08,             ///< Device class.
         BAR = 0x10,               ///< First BAR.
         HEADER_TYPE = 0x0c,       ///< PCI header type.
@@ -153,6 +160,12 @@ class pci_device
         return class_code() == PCI_CLASS_SIMPLE_COMM and subclass() == PCI_SUBCLASS_SERIAL;
     }
 
+    /// Enables memory decoding and lets the device do DMA.
+    void enable_bus_master() const
+    {
+        *ptr<uint16_t>(uintptr_t(offset::COMMAND)) |= COMMAND_MEMORY_SPACE | COMMAND_BUS_MASTER;
+    }
+
     using bar_t = pci::bar_t;  ///< Alias to the BAR structure.
 
     /// Returns a pointer to BAR i.
@@ -232,6 +245,12 @@ class pci_device
             return o.off != off;
         }
 
+        /// Returns the config space offset of the current capability.
+        uint8_t offset() const
+        {
+            return off;
+        }
+
         /// Jump to next capability.
         capability_iterator& operator++()
         {
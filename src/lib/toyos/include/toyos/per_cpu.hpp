@@ -0,0 +1,136 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <compiler.hpp>
+#include <config.hpp>
+
+/**
+ * The per-CPU control block. IA32_GS_BASE of every CPU points to its own
+ * instance, so fields can be read with a single GS-relative load.
+ */
+struct alignas(CPU_CACHE_LINE_SIZE) cpu_local_area
+{
+    // Must stay the first member: %gs:0 yields the linear address of the area.
+    cpu_local_area* self;
+
+    // Dense, zero-based CPU index. The BSP always has index 0.
+    uint32_t cpu_index;
+
+    // Initial APIC ID as reported by CPUID.
+    uint32_t apic_id;
+};
+
+/**
+ * Initializes the control block of the calling CPU and points IA32_GS_BASE
+ * to it.
+ *
+ * This has to be called on every CPU before any per-CPU data is accessed.
+ * The BSP does this during early boot.
+ */
+void init_cpu_local(uint32_t cpu_index);
+
+/// Returns the control block of the given CPU.
+cpu_local_area& cpu_local_area_of(size_t cpu_index);
+
+/// Returns the number of CPUs that have initialized their control block.
+size_t online_cpus();
+
+/// Returns the index of the calling CPU.
+inline uint32_t current_cpu()
+{
+    uint32_t idx;
+    asm("movl %%gs:%c[off], %[idx]"
+        : [idx] "=r"(idx)
+        : [off] "i"(offsetof(cpu_local_area, cpu_index)));
+    return idx;
+}
+
+/// Returns the control block of the calling CPU.
+inline cpu_local_area& this_cpu()
+{
+    cpu_local_area* self;
+    asm("mov %%gs:%c[off], %[self]"
+        : [self] "=r"(self)
+        : [off] "i"(offsetof(cpu_local_area, self)));
+    return *self;
+}
+
+/**
+ * Typed per-CPU storage.
+ *
+ * Every CPU gets its own instance of T. Instances are padded to a full
+ * cache line, so CPUs updating their local copy never share a line.
+ *
+ * Example:
+ *
+ *   static per_cpu<uint64_t> counter;
+ *   counter.local()++;
+ */
+template<typename T>
+class per_cpu
+{
+    struct alignas(CPU_CACHE_LINE_SIZE) slot
+    {
+        T value;
+    };
+
+    std::array<slot, MAX_CPUS> slots_{};
+
+ public:
+    per_cpu() = default;
+
+    explicit per_cpu(const T& initial)
+    {
+        for (auto& s : slots_) {
+            s.value = initial;
+        }
+    }
+
+    /// The instance of the calling CPU.
+    T& local()
+    {
+        return slots_[current_cpu()].value;
+    }
+
+    const T& local() const
+    {
+        return slots_[current_cpu()].value;
+    }
+
+    T& operator*()
+    {
+        return local();
+    }
+
+    T* operator->()
+    {
+        return &local();
+    }
+
+    /// The instance of an arbitrary CPU. Accessing remote instances needs
+    /// synchronization by the caller.
+    T& operator[](size_t cpu_index)
+    {
+        return slots_[cpu_index].value;
+    }
+
+    const T& operator[](size_t cpu_index) const
+    {
+        return slots_[cpu_index].value;
+    }
+
+    /// Calls fn(cpu_index, instance) for every online CPU.
+    template<typename FN>
+    void for_each_online(FN fn)
+    {
+        for (size_t cpu{ 0 }; cpu < online_cpus(); cpu++) {
+            fn(cpu, slots_[cpu].value);
+        }
+    }
+};
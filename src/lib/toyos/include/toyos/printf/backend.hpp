@@ -3,16 +3,46 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <string>
+
 using printf_backend_fn = void (*)(unsigned char);
+using printf_write_fn = void (*)(const char*, size_t);
+
+struct printf_backend
+{
+    printf_backend_fn putc;
+    printf_write_fn write;
+};
+
+// The library could be used in context where dynamic memory allocation
+// is unsupported, e.g. in early boot stages.
+// Hence, the number of possible backends is fixed.
+static constexpr size_t MAX_PRINTF_BACKENDS{ 3 };
+
+using printf_backend_list = std::array<printf_backend, MAX_PRINTF_BACKENDS>;
 
 #ifdef PRINTF_BACKENDS_DISABLED
 
-static inline void add_printf_backend(printf_backend_fn)
+static inline void add_printf_backend(printf_backend_fn, printf_write_fn = nullptr)
 {}
 static inline void remove_printf_backend(printf_backend_fn)
 {}
 static inline void remove_all_printf_backends()
 {}
+static inline void capture_printf_output(std::string*)
+{}
+static inline void print_to_backends(const std::string&)
+{}
+static inline void flush_printf_output()
+{}
+static inline void write_printf_output(const char*, size_t)
+{}
+static inline printf_backend_list exchange_printf_backends(const printf_backend_list&)
+{
+    return {};
+}
 
 #else
 
@@ -20,8 +50,38 @@ static inline void remove_all_printf_backends()
 ///
 /// Normal printing functions, such as printf, will call this function for every character they need to print. This
 /// function does not do anything in a hosted environment as all output goes via the normal libc.
-void add_printf_backend(printf_backend_fn backend);
+///
+/// Output is buffered and handed to the backends in chunks. If a backend provides a write function, it receives each
+/// chunk with a single call. Otherwise, the backend function is called for every character.
+void add_printf_backend(printf_backend_fn backend, printf_write_fn write = nullptr);
 void remove_printf_backend(printf_backend_fn backend);
 void remove_all_printf_backends();
 
+/// Replace all backends at once and return the previous ones.
+///
+/// Queued output is written to the previous backends first.
+printf_backend_list exchange_printf_backends(const printf_backend_list& replacement);
+
+/// Redirect the printf output of the calling CPU into a buffer.
+///
+/// While a buffer is set, output of the calling CPU is appended to it instead
+/// of being sent to the backends. Passing nullptr restores regular output.
+void capture_printf_output(std::string* buffer);
+
+/// Send already formatted output to all backends at once.
+///
+/// The output of other CPUs cannot interleave with it.
+void print_to_backends(const std::string& output);
+
+/// Hand already formatted output to the backends like printf() does.
+///
+/// The output must already contain \r\n line endings.
+void write_printf_output(const char* data, size_t size);
+
+/// Write out all output that is still queued, including an incomplete line
+/// of the calling CPU.
+///
+/// As long as APs are online, output is only written in complete lines.
+void flush_printf_output();
+
 #endif
@@ -0,0 +1,465 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <pprintpp/pprintpp.hpp>
+#include <toyos/printf/backend.hpp>
+
+#ifdef HOSTED
+#include <cstdio>
+#else
+#include <toyos/printf/xprintf.h>
+#endif
+
+/**
+ * Compile-time specialized printf.
+ *
+ * pprintpp turns a format string with {} placeholders into a printf format
+ * string at compile time, but printf still has to parse it on every call.
+ * Here, the printf format string is parsed at compile time as well. Every
+ * call site gets its own sequence of append operations, and numbers are
+ * converted two digits at a time.
+ *
+ * The output matches that of xprintf, including the \n -> \r\n conversion.
+ * Format strings with conversions we don't handle fall back to printf.
+ *
+ * Example:
+ *
+ *   compiled_pprintf("value {#x} at {}\n", value, index);
+ */
+namespace compiled_format
+{
+
+    enum class op_kind : uint8_t
+    {
+        LITERAL,
+        NEWLINE,
+        CHAR,
+        STRING,
+        SIGNED,
+        UNSIGNED,
+        HEX,
+        POINTER,
+    };
+
+    struct op
+    {
+        op_kind kind;
+        uint16_t begin;   ///< Start of a literal in the format string
+        uint16_t length;  ///< Length of a literal
+        uint16_t width;
+        bool prefix_0x;
+        bool zero_padding;
+        bool left_justified;
+        bool upper_case;
+        bool long_size;
+    };
+
+    /**
+     * Walks a printf format string like xprintf does and calls emit(op) for
+     * every operation.
+     *
+     * \return False, if the format string contains conversions we can't handle.
+     */
+    template<typename FN>
+    constexpr bool parse(const char* fmt, FN emit)
+    {
+        size_t pos{ 0 };
+
+        while (fmt[pos] != '\0') {
+            auto literal_start{ pos };
+            while (fmt[pos] != '\0' and fmt[pos] != '%' and fmt[pos] != '\n') {
+                pos++;
+            }
+
+            if (pos != literal_start) {
+                emit(op{ op_kind::LITERAL, static_cast<uint16_t>(literal_start), static_cast<uint16_t>(pos - literal_start), 0, false, false, false, false, false });
+            }
+
+            if (fmt[pos] == '\n') {
+                emit(op{ op_kind::NEWLINE, 0, 0, 0, false, false, false, false, false });
+                pos++;
+                continue;
+            }
+
+            if (fmt[pos] == '\0') {
+                break;
+            }
+
+            op o{ op_kind::LITERAL, 0, 0, 0, false, false, false, false, false };
+            char c{ fmt[++pos] };
+
+            if (c == '#') {
+                o.prefix_0x = true;
+                c = fmt[++pos];
+            }
+            if (c == '0') {
+                o.zero_padding = true;
+                c = fmt[++pos];
+            }
+            else if (c == '-') {
+                o.left_justified = true;
+                c = fmt[++pos];
+            }
+            for (; c >= '0' and c <= '9'; c = fmt[++pos]) {
+                o.width = static_cast<uint16_t>(o.width * 10 + (c - '0'));
+            }
+            for (size_t i{ 0 }; i < 2 and (c == 'l' or c == 'L'); i++) {
+                o.long_size = true;
+                c = fmt[++pos];
+            }
+
+            // Like xprintf, we print lower case digits only for an x.
+            o.upper_case = c != 'x';
+
+            switch (c) {
+                case 's':
+                case 'S':
+                    o.kind = op_kind::STRING;
+                    break;
+                case 'c':
+                case 'C':
+                    o.kind = op_kind::CHAR;
+                    break;
+                case 'd':
+                case 'D':
+                    o.kind = op_kind::SIGNED;
+                    break;
+                case 'u':
+                case 'U':
+                    o.kind = op_kind::UNSIGNED;
+                    break;
+                case 'x':
+                case 'X':
+                    o.kind = op_kind::HEX;
+                    break;
+                case 'p':
+                case 'P':
+                    o.kind = op_kind::POINTER;
+                    break;
+                case 'b':
+                case 'B':
+                case 'o':
+                case 'O':
+                case '\0':
+                    return false;
+                default:
+                    // Unknown conversions are passed through without consuming an argument.
+                    o.begin = static_cast<uint16_t>(pos);
+                    o.length = 1;
+                    if (o.prefix_0x) {
+                        return false;
+                    }
+            }
+
+            emit(o);
+            pos++;
+        }
+
+        return true;
+    }
+
+    template<char... Cs>
+    struct format
+    {
+        static constexpr char text[]{ Cs..., '\0' };
+
+        static constexpr size_t count_ops()
+        {
+            size_t count{ 0 };
+            parse(text, [&count](const op&) { count++; });
+            return count;
+        }
+
+        static constexpr std::array<op, count_ops()> make_ops()
+        {
+            std::array<op, count_ops()> result{};
+            size_t i{ 0 };
+            parse(text, [&](const op& o) { result[i++] = o; });
+            return result;
+        }
+
+        static constexpr bool supported{ parse(text, [](const op&) {}) };
+        static constexpr std::array<op, count_ops()> ops{ make_ops() };
+    };
+
+    /// Collects the characters of a pprintpp type list into a format.
+    template<typename TL, char... Cs>
+    struct format_of;
+
+    template<char C, typename REST, char... Cs>
+    struct format_of<pprintpp::tl<pprintpp::char_t<C>, REST>, Cs...> : format_of<REST, Cs..., C>
+    {};
+
+    template<char... Cs>
+    struct format_of<pprintpp::null_t, Cs...>
+    {
+        using type = format<Cs...>;
+    };
+
+    /// "00" "01" ... "99"
+    inline constexpr auto decimal_pairs{ [] {
+        std::array<char, 200> pairs{};
+        for (size_t i{ 0 }; i < 100; i++) {
+            pairs[2 * i] = static_cast<char>('0' + i / 10);
+            pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+        return pairs;
+    }() };
+
+    /// "00" "01" ... "ff", followed by "00" ... "FF"
+    inline constexpr auto hex_pairs{ [] {
+        constexpr char lower[]{ "0123456789abcdef" };
+        constexpr char upper[]{ "0123456789ABCDEF" };
+        std::array<char, 1024> pairs{};
+        for (size_t i{ 0 }; i < 256; i++) {
+            pairs[2 * i] = lower[i >> 4];
+            pairs[2 * i + 1] = lower[i & 0xf];
+            pairs[512 + 2 * i] = upper[i >> 4];
+            pairs[512 + 2 * i + 1] = upper[i & 0xf];
+        }
+        return pairs;
+    }() };
+
+    /// Collects output on the stack and hands it to the printf backends in one go.
+    class sink
+    {
+     public:
+        ~sink()
+        {
+            write_printf_output(buffer_.data(), size_);
+        }
+
+        void put(char c)
+        {
+            if (size_ == buffer_.size()) {
+                flush();
+            }
+            buffer_[size_++] = c;
+        }
+
+        void append(const char* data, size_t size)
+        {
+            while (size > 0) {
+                if (size_ == buffer_.size()) {
+                    flush();
+                }
+
+                auto chunk{ size < buffer_.size() - size_ ? size : buffer_.size() - size_ };
+                memcpy(buffer_.data() + size_, data, chunk);
+                size_ += chunk;
+                data += chunk;
+                size -= chunk;
+            }
+        }
+
+        void put_converted(char c)
+        {
+            if (c == '\n') {
+                put('\r');
+            }
+            put(c);
+        }
+
+        void fill(char c, size_t count)
+        {
+            for (size_t i{ 0 }; i < count; i++) {
+                put(c);
+            }
+        }
+
+     private:
+        void flush()
+        {
+            write_printf_output(buffer_.data(), size_);
+            size_ = 0;
+        }
+
+        std::array<char, 256> buffer_;
+        size_t size_{ 0 };
+    };
+
+    inline void append_padded(sink& out, const char* digits, size_t length, const op& o)
+    {
+        auto padding{ o.width > length ? o.width - length : 0 };
+
+        if (not o.left_justified) {
+            out.fill(o.zero_padding ? '0' : ' ', padding);
+        }
+        out.append(digits, length);
+        if (o.left_justified) {
+            out.fill(' ', padding);
+        }
+    }
+
+    inline void append_decimal(sink& out, uint64_t v, bool negative, const op& o)
+    {
+        std::array<char, 24> digits;
+        auto* end{ digits.data() + digits.size() };
+        auto* p{ end };
+
+        while (v >= 100) {
+            p -= 2;
+            memcpy(p, &decimal_pairs[2 * (v % 100)], 2);
+            v /= 100;
+        }
+        if (v >= 10) {
+            p -= 2;
+            memcpy(p, &decimal_pairs[2 * v], 2);
+        }
+        else {
+            *--p = static_cast<char>('0' + v);
+        }
+
+        if (negative) {
+            *--p = '-';
+        }
+
+        append_padded(out, p, static_cast<size_t>(end - p), o);
+    }
+
+    inline void append_signed(sink& out, int64_t v, const op& o)
+    {
+        auto magnitude{ static_cast<uint64_t>(v) };
+        append_decimal(out, v < 0 ? 0 - magnitude : magnitude, v < 0, o);
+    }
+
+    inline void append_hex(sink& out, uint64_t v, const op& o)
+    {
+        std::array<char, 16> digits;
+        auto* end{ digits.data() + digits.size() };
+        auto* p{ end };
+        const auto* pairs{ hex_pairs.data() + (o.upper_case ? 512 : 0) };
+
+        while (v >= 0x100) {
+            p -= 2;
+            memcpy(p, &pairs[2 * (v & 0xff)], 2);
+            v >>= 8;
+        }
+        if (v >= 0x10) {
+            p -= 2;
+            memcpy(p, &pairs[2 * v], 2);
+        }
+        else {
+            *--p = pairs[2 * v + 1];
+        }
+
+        append_padded(out, p, static_cast<size_t>(end - p), o);
+    }
+
+    inline void append_string(sink& out, const char* str, const op& o)
+    {
+        auto length{ strlen(str) };
+        auto padding{ o.width > length ? o.width - length : 0 };
+
+        if (not o.left_justified) {
+            out.fill(' ', padding);
+        }
+        for (size_t i{ 0 }; i < length; i++) {
+            out.put_converted(str[i]);
+        }
+        if (o.left_justified) {
+            out.fill(' ', padding);
+        }
+    }
+
+    template<typename FMT, size_t I, typename T>
+    inline void append_arg(sink& out, T arg)
+    {
+        constexpr op O{ FMT::ops[I] };
+
+        if constexpr (O.prefix_0x) {
+            out.append("0x", 2);
+        }
+
+        if constexpr (O.kind == op_kind::STRING) {
+            append_string(out, arg, O);
+        }
+        else if constexpr (O.kind == op_kind::CHAR) {
+            char c = arg;
+            out.put_converted(c);
+        }
+        else if constexpr (O.kind == op_kind::POINTER) {
+            out.append("0x", 2);
+            append_hex(out, reinterpret_cast<uintptr_t>(arg), O);
+        }
+        else if constexpr (O.kind == op_kind::SIGNED) {
+            // Like xprintf, we read an int unless there is a length modifier.
+            std::conditional_t<O.long_size, int64_t, int32_t> v = arg;
+            append_signed(out, v, O);
+        }
+        else {
+            std::conditional_t<O.long_size, uint64_t, uint32_t> v = arg;
+            if constexpr (O.kind == op_kind::UNSIGNED) {
+                append_decimal(out, v, false, O);
+            }
+            else {
+                append_hex(out, v, O);
+            }
+        }
+    }
+
+    template<typename FMT, size_t I, typename... Ts>
+    inline void run(sink& out, Ts... args);
+
+    template<typename FMT, size_t I, typename T, typename... Ts>
+    inline void run_arg(sink& out, T arg, Ts... rest)
+    {
+        append_arg<FMT, I>(out, arg);
+        run<FMT, I + 1>(out, rest...);
+    }
+
+    template<typename FMT, size_t I, typename... Ts>
+    inline void run(sink& out, Ts... args)
+    {
+        if constexpr (I < FMT::ops.size()) {
+            constexpr const op& o{ FMT::ops[I] };
+
+            if constexpr (o.kind == op_kind::LITERAL) {
+                out.append(FMT::text + o.begin, o.length);
+                run<FMT, I + 1>(out, args...);
+            }
+            else if constexpr (o.kind == op_kind::NEWLINE) {
+                out.append("\r\n", 2);
+                run<FMT, I + 1>(out, args...);
+            }
+            else {
+                run_arg<FMT, I>(out, args...);
+            }
+        }
+    }
+
+    template<typename TL, typename... Ts>
+    inline void print(Ts... args)
+    {
+        using fmt = typename format_of<TL>::type;
+
+        if constexpr (fmt::supported) {
+            sink out;
+            run<fmt, 0>(out, args...);
+        }
+        else {
+            printf(fmt::text, args...);
+        }
+    }
+
+}  // namespace compiled_format
+
+#define compiled_pprintf(s, ...)                                                                                    \
+    do {                                                                                                            \
+        struct compiled_format_string                                                                               \
+        {                                                                                                           \
+            static constexpr const char* str() { return s; }                                                        \
+        };                                                                                                          \
+        using compiled_format_types = decltype(pprintpp::tie_types(__VA_ARGS__));                                   \
+        using compiled_format_list = typename pprintpp::autoformat<pprintpp::string_list_t<compiled_format_string>, \
+                                                                   compiled_format_types>::type;                    \
+        compiled_format::print<compiled_format_list>(__VA_ARGS__);                                                  \
+    } while (0)
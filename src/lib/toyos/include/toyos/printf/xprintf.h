@@ -22,6 +22,10 @@ extern "C"
 #define xdev_out(func) xfunc_out = func
     extern void (*xfunc_out)(unsigned char);
 
+/* Called after each putc/puts/printf call, so buffered output can be written in bulk. */
+#define xdev_flush(func) xfunc_flush = func
+    extern void (*xfunc_flush)(void);
+
 #ifndef LIB_TYPE_HOSTED
     int putc(char c);
     int putchar(int c);
@@ -0,0 +1,56 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include <toyos/per_cpu.hpp>
+
+/**
+ * Support for application processors (APs).
+ *
+ * APs are not started during boot, because most tests only need the BSP and
+ * spinning APs would only steal time from the host. Tests that want to use
+ * additional CPUs call start_aps() first. Started APs wait for work that the
+ * BSP hands to them with run_on_cpu().
+ */
+namespace smp
+{
+
+    using job_fn = std::function<void()>;
+
+    /**
+     * Starts all APs via INIT-SIPI-SIPI and waits until they are online.
+     *
+     * This function is idempotent.
+     *
+     * \return The number of online CPUs, including the BSP.
+     */
+    size_t start_aps();
+
+    /// Returns true if the given CPU is online and not executing a job.
+    bool cpu_idle(size_t cpu);
+
+    /**
+     * Hands a job to an idle AP without waiting for its completion.
+     *
+     * The CPU must be online and idle.
+     */
+    void run_on_cpu_async(size_t cpu, const job_fn& fn);
+
+    /// Waits until the given CPU has finished its current job.
+    void wait_for_cpu(size_t cpu);
+
+    /**
+     * Executes a job on the given CPU and waits for its completion.
+     *
+     * If cpu is the calling CPU, the job is executed directly.
+     */
+    void run_on_cpu(size_t cpu, const job_fn& fn);
+
+    /// Executes fn(cpu) on all online CPUs, including the caller, and waits for all of them.
+    void run_on_all_cpus(const std::function<void(size_t)>& fn);
+
+}  // namespace smp
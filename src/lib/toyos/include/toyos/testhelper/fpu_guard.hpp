@@ -0,0 +1,59 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/x86/x86asm.hpp>
+#include <toyos/x86/x86defs.hpp>
+#include <toyos/x86/x86fpu.hpp>
+
+/**
+ * Enables the FPU, SSE and, if available, AVX while it lives and restores
+ * CR0, CR4 and XCR0 afterwards.
+ *
+ * toyOS is built without SSE and never saves vector registers, so the vector
+ * registers may only be used by inline assembly within the guarded region.
+ */
+class fpu_guard
+{
+ public:
+    fpu_guard()
+        : cr0_(get_cr0()), cr4_(get_cr4()), xcr0_(osxsave_enabled(cr4_) ? get_xcr() : 0)
+    {
+        set_cr0((cr0_ & ~math::mask_from(x86::cr0::EM, x86::cr0::TS)) | math::mask_from(x86::cr0::MP));
+        set_cr4(cr4_ | math::mask_from(x86::cr4::OSFXSR, x86::cr4::OSXMMEXCEPT));
+
+        if (xsave_supported()) {
+            auto supported{ cpuid(CPUID_LEAF_EXTENDED_STATE, CPUID_EXTENDED_STATE_MAIN).eax };
+            set_cr4(get_cr4() | math::mask_from(x86::cr4::OSXSAVE));
+            set_xcr(supported & (x86::XCR0_FPU | x86::XCR0_SSE | x86::XCR0_AVX));
+        }
+
+        asm volatile("fninit");
+    }
+
+    ~fpu_guard()
+    {
+        if (osxsave_enabled(cr4_)) {
+            set_xcr(xcr0_);
+        }
+        set_cr4(cr4_);
+        set_cr0(cr0_);
+    }
+
+    /// Returns true if AVX instructions can be used in the guarded region.
+    static bool avx_usable()
+    {
+        return avx_supported() and xsave_supported();
+    }
+
+ private:
+    static bool osxsave_enabled(uint64_t cr4)
+    {
+        return cr4 & math::mask_from(x86::cr4::OSXSAVE);
+    }
+
+    const uint64_t cr0_;
+    const uint64_t cr4_;
+    const uint64_t xcr0_;
+};
@@ -8,8 +8,7 @@
 
 /**
  * A driver for the Intel 8253/8254 Programmable Interval Timer (PIT).
- * You can only choose the operating mode, everything else is always:
- *  channel:        channel 0
+ * You can only choose the operating mode and the channel, everything else is always:
  *  access mode:    lowest byte then highest byte
  *  counter format: binary
  *
@@ -17,6 +16,9 @@
  *      interrupt on terminal count (oneshot-mode)
  *      rate generator (periodic interrupts)
  *
+ *  The supported channels are channel 0, which raises IRQ 0, and channel 2,
+ *  whose output can be polled.
+ *
  *  Everything else is not supported and will panic.
  */
 class pit
@@ -26,6 +28,12 @@ class pit
     static constexpr uint16_t DATA2{ 0x42 };
     static constexpr uint16_t MODE{ 0x43 };
 
+    // Channel 2 is gated and read via the PC speaker control port.
+    static constexpr uint16_t SPEAKER_CONTROL{ 0x61 };
+    static constexpr uint8_t SPEAKER_GATE{ 1u << 0 };
+    static constexpr uint8_t SPEAKER_DATA{ 1u << 1 };
+    static constexpr uint8_t SPEAKER_CHANNEL_2_OUT{ 1u << 5 };
+
     enum
     {
         FORMAT_BITS = 1,
@@ -44,15 +52,6 @@ class pit
         CHANNEL_MASK = math::mask(CHANNEL_BITS, CHANNEL_SHIFT),
     };
 
-    /// The output channel the PIT will use
-    enum class channel
-    {
-        CHANNEL_0 = 0,  /// interrupt 0
-        CHANNEL_1 = 1,  /// was once used to refresh the DRAM, not usable anymore
-        CHANNEL_2 = 2,  /// connected to the PC speaker
-        READ_BACK = 3,  /// read-back command to read a status value for a selected channel
-    };
-
     /// How to access the reload register
     enum class access_mode
     {
@@ -70,6 +69,18 @@ class pit
     };
 
  public:
+    /// The frequency all channels count with
+    static constexpr uint64_t FREQUENCY_HZ{ 1193182 };
+
+    /// The output channel the PIT will use
+    enum class channel
+    {
+        CHANNEL_0 = 0,  /// interrupt 0
+        CHANNEL_1 = 1,  /// was once used to refresh the DRAM, not usable anymore
+        CHANNEL_2 = 2,  /// connected to the PC speaker
+        READ_BACK = 3,  /// read-back command to read a status value for a selected channel
+    };
+
     /// Determines how the pit works, e.g. creating one interrupt or periodic interrupts
     enum class operating_mode
     {
@@ -85,9 +96,12 @@ class pit
      * Constructor configuring the PIT with the given values
      *
      * \param op_mode The operating mode to be used
+     * \param ch      The channel to be used
      */
-    pit(operating_mode op_mode)
+    pit(operating_mode op_mode, channel ch = channel::CHANNEL_0)
+        : channel_(ch), data_port_(DATA0 + static_cast<uint16_t>(ch))
     {
+        PANIC_UNLESS(ch == channel::CHANNEL_0 || ch == channel::CHANNEL_2, "You chose an unsupported channel!");
         set_operating_mode(op_mode);
     }
 
@@ -116,11 +130,35 @@ class pit
         outb(data_port_, (value >> 8) & 0xff);
     }
 
+    /**
+     * Lets channel 2 count or stops it. The speaker stays silent.
+     *
+     * \param enable Whether the channel counts
+     */
+    void set_gate(bool enable)
+    {
+        PANIC_UNLESS(channel_ == channel::CHANNEL_2, "Only channel 2 has a software-controlled gate!");
+        uint8_t control = inb(SPEAKER_CONTROL) & ~(SPEAKER_GATE | SPEAKER_DATA);
+        outb(SPEAKER_CONTROL, control | (enable ? SPEAKER_GATE : 0));
+    }
+
+    /**
+     * Reads the output of channel 2.
+     *
+     * In the interrupt on terminal count mode, the output goes high when the
+     * counter reaches zero.
+     */
+    bool output() const
+    {
+        PANIC_UNLESS(channel_ == channel::CHANNEL_2, "Only the output of channel 2 can be read!");
+        return inb(SPEAKER_CONTROL) & SPEAKER_CHANNEL_2_OUT;
+    }
+
  private:
-    const channel channel_{ channel::CHANNEL_0 };
+    const channel channel_;
     const access_mode acc_mode_{ access_mode::LO_HIBYTE };
     const counter_format format_{ counter_format::BINARY };
-    const uint16_t data_port_{ DATA0 };
+    const uint16_t data_port_;
 
     operating_mode op_mode_;
 
@@ -0,0 +1,109 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <toyos/testhelper/pit.hpp>
+#include <toyos/util/cpuid.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+#include <cstdint>
+
+namespace tsc
+{
+
+    /**
+     * Measures the TSC frequency against PIT channel 2.
+     *
+     * Channel 2 is gated by the PC speaker port and its output can be polled,
+     * so neither interrupts nor channel 0 are involved.
+     *
+     * \return The TSC ticks per microsecond or 0 if there is no working PIT.
+     */
+    inline uint64_t measure_ticks_per_us_with_pit()
+    {
+        static constexpr uint64_t MEASURE_MS{ 50 };
+        static constexpr uint16_t LATCH{ pit::FREQUENCY_HZ * MEASURE_MS / 1000 };
+
+        // A TSC faster than 10 GHz is implausible, so the PIT is broken if it
+        // takes longer than that.
+        static constexpr uint64_t MAX_TICKS{ MEASURE_MS * 1000 * 10'000 };
+
+        pit channel_2{ pit::operating_mode::INTERRUPT_ON_TERMINAL_COUNT, pit::channel::CHANNEL_2 };
+        channel_2.set_gate(true);
+        channel_2.set_counter(LATCH);
+
+        // Without a PIT, the speaker port reads as all ones, which looks
+        // like an expired counter.
+        if (channel_2.output()) {
+            channel_2.set_gate(false);
+            return 0;
+        }
+
+        auto start{ rdtsc() };
+        while (not channel_2.output()) {
+            if (rdtsc() - start > MAX_TICKS) {
+                channel_2.set_gate(false);
+                return 0;
+            }
+            cpu_pause();
+        }
+        auto ticks{ rdtsc() - start };
+
+        channel_2.set_gate(false);
+        return ticks / (MEASURE_MS * 1000);
+    }
+
+    /**
+     * Returns the TSC ticks per microsecond or 0 if the frequency is unknown.
+     *
+     * The frequency is taken from CPUID if the CPU reports it and measured
+     * with the PIT otherwise. The measurement takes 50ms and is only done on
+     * the first call. Some VMMs have neither, so callers have to cope with an
+     * unknown frequency, e.g. by reporting cycles.
+     */
+    inline uint64_t ticks_per_us()
+    {
+        static const uint64_t ticks{ [] {
+            auto hz{ util::cpuid::tsc_frequency_hz() };
+            return hz != 0 ? hz / 1000000 : measure_ticks_per_us_with_pit();
+        }() };
+        return ticks;
+    }
+
+    /// Returns true if TSC ticks can be converted to time.
+    inline bool frequency_known()
+    {
+        return ticks_per_us() != 0;
+    }
+
+    /// Converts TSC ticks to nanoseconds. Returns 0 if the frequency is unknown.
+    inline uint64_t ticks_to_ns(uint64_t ticks)
+    {
+        return frequency_known() ? ticks * 1000 / ticks_per_us() : 0;
+    }
+
+    /**
+     * Returns the rate of bytes transferred within the given TSC ticks in
+     * bytes per second. Returns 0 if the frequency is unknown.
+     *
+     * Meant for slow devices. The intermediate result overflows for more than
+     * a few GB.
+     */
+    inline uint64_t bytes_per_s(uint64_t bytes, uint64_t ticks)
+    {
+        return ticks == 0 ? 0 : bytes * ticks_per_us() * 1000000 / ticks;
+    }
+
+    /**
+     * Returns the rate of bytes transferred within the given TSC ticks in MB/s
+     * (10^6 bytes per second). Returns 0 if the frequency is unknown.
+     */
+    inline uint64_t mb_per_s(uint64_t bytes, uint64_t ticks)
+    {
+        // One byte per microsecond is one MB/s.
+        return ticks == 0 ? 0 : bytes * ticks_per_us() / ticks;
+    }
+
+}  // namespace tsc
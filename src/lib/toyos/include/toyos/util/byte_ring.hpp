@@ -0,0 +1,101 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace cbl
+{
+
+    /**
+     * A fixed-size ring of bytes for a single producer and consumer.
+     *
+     * Writing to a full ring overwrites the oldest bytes. The number of
+     * overwritten bytes is counted until the ring is drained.
+     *
+     * \tparam SIZE The capacity of the ring in bytes.
+     */
+    template<size_t SIZE>
+    class byte_ring
+    {
+        static_assert(SIZE > 0, "The ring needs space for at least one byte");
+
+     public:
+        /// Appends data and drops the oldest bytes if there is not enough space.
+        void write(const char* data, size_t size)
+        {
+            // Only the tail of large writes survives anyway.
+            if (size > SIZE) {
+                dropped_ += size - SIZE;
+                data += size - SIZE;
+                size = SIZE;
+            }
+
+            auto overflow{ (used() + size > SIZE) ? used() + size - SIZE : 0 };
+            tail_ += overflow;
+            dropped_ += overflow;
+
+            auto pos{ head_ % SIZE };
+            auto first{ std::min(size, SIZE - pos) };
+            memcpy(buffer_.data() + pos, data, first);
+            memcpy(buffer_.data(), data + first, size - first);
+            head_ += size;
+        }
+
+        /// Returns the number of bytes in the ring.
+        size_t used() const
+        {
+            return head_ - tail_;
+        }
+
+        bool empty() const
+        {
+            return head_ == tail_;
+        }
+
+        /// Returns the number of bytes that were overwritten since the last drain.
+        uint64_t dropped() const
+        {
+            return dropped_;
+        }
+
+        /**
+         * Hands the content of the ring to fn in order and empties the ring.
+         *
+         * fn is called with (const char* data, size_t size) for at most two
+         * contiguous parts of the ring.
+         */
+        template<typename FN>
+        void drain(FN&& fn)
+        {
+            auto pos{ tail_ % SIZE };
+            auto size{ used() };
+            auto first{ std::min(size, SIZE - pos) };
+
+            if (first != 0) {
+                fn(buffer_.data() + pos, first);
+            }
+            if (size != first) {
+                fn(buffer_.data(), size - first);
+            }
+
+            tail_ = head_;
+            dropped_ = 0;
+        }
+
+     private:
+        std::array<char, SIZE> buffer_;
+
+        // Both only grow, their difference is the number of used bytes.
+        uint64_t head_{ 0 };
+        uint64_t tail_{ 0 };
+
+        uint64_t dropped_{ 0 };
+    };
+
+}  // namespace cbl
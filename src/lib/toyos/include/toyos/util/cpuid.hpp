@@ -14,6 +14,33 @@ namespace util::cpuid
         return ::cpuid(CPUID_LEAF_FAMILY_FEATURES).ecx & LVL_0000_0001_ECX_HV;
     }
 
+    /// Returns true if the CPU supports 1 GiB pages.
+    inline bool has_1gb_pages()
+    {
+        if (::cpuid(CPUID_LEAF_EXTENDED_MAX_LEVEL).eax < CPUID_LEAF_EXTENDED_FAMILY_FEATURES) {
+            return false;
+        }
+        return ::cpuid(CPUID_LEAF_EXTENDED_FAMILY_FEATURES).edx & LVL_8000_0001_EDX_PG1G;
+    }
+
+    /**
+     * Returns the TSC frequency in Hz as enumerated in the TSC/crystal clock
+     * leaf, or 0 if the CPU does not report it.
+     */
+    inline uint64_t tsc_frequency_hz()
+    {
+        if (::cpuid(CPUID_LEAF_MAX_LEVEL_VENDOR_ID).eax < CPUID_LEAF_TSC_FREQUENCY) {
+            return 0;
+        }
+
+        // EAX and EBX are the TSC to crystal clock ratio, ECX is the crystal clock.
+        auto res{ ::cpuid(CPUID_LEAF_TSC_FREQUENCY) };
+        if (res.eax == 0 or res.ebx == 0) {
+            return 0;
+        }
+        return uint64_t(res.ecx) * res.ebx / res.eax;
+    }
+
     /**
      * Return the vendor ID string from CPUID by reading the respective leaf
      * and combining EBX-ECX-EDX to a string.
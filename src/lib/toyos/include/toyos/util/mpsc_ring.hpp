@@ -0,0 +1,126 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <config.hpp>
+#include <toyos/util/math.hpp>
+
+namespace cbl
+{
+
+    /**
+     * A bounded lock-free ring for multiple producers and a single consumer.
+     *
+     * Every slot carries a sequence number that tells producers and the
+     * consumer whether the slot is free or holds a committed element. A
+     * producer claims a slot with a single CAS on the write position and
+     * never waits for other producers or the consumer.
+     *
+     * Only one consumer may call consume() at a time. The caller is
+     * responsible for that exclusion.
+     *
+     * \tparam T        Type of the stored elements
+     * \tparam MAX_SIZE Number of slots, must be a power of two
+     */
+    template<class T, size_t MAX_SIZE>
+    class mpsc_ring
+    {
+        static_assert(math::is_power_of_2(MAX_SIZE));
+
+        static constexpr uint64_t INDEX_MASK{ MAX_SIZE - 1 };
+
+        struct slot
+        {
+            uint64_t sequence;
+            T element;
+        };
+
+        alignas(CPU_CACHE_LINE_SIZE) uint64_t write_position_{ 0 };
+        alignas(CPU_CACHE_LINE_SIZE) uint64_t read_position_{ 0 };
+        alignas(CPU_CACHE_LINE_SIZE) std::array<slot, MAX_SIZE> slots_;
+
+     public:
+        mpsc_ring()
+        {
+            for (uint64_t i{ 0 }; i < MAX_SIZE; i++) {
+                slots_[i].sequence = i;
+            }
+        }
+
+        /**
+         * Claims a slot and lets fill(T&) write the element in place.
+         * \return True iff there was a free slot.
+         */
+        template<typename FN>
+        bool emplace(FN fill)
+        {
+            auto pos{ __atomic_load_n(&write_position_, __ATOMIC_RELAXED) };
+            slot* s;
+
+            while (true) {
+                s = &slots_[pos & INDEX_MASK];
+                auto seq{ __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE) };
+                auto diff{ static_cast<int64_t>(seq - pos) };
+
+                if (diff == 0) {
+                    if (__atomic_compare_exchange_n(&write_position_, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                        break;
+                    }
+                }
+                else if (diff < 0) {
+                    // The consumer has not freed this slot yet.
+                    return false;
+                }
+                else {
+                    pos = __atomic_load_n(&write_position_, __ATOMIC_RELAXED);
+                }
+            }
+
+            fill(s->element);
+            __atomic_store_n(&s->sequence, pos + 1, __ATOMIC_RELEASE);
+
+            return true;
+        }
+
+        bool push(const T& elem)
+        {
+            return emplace([&elem](T& e) { e = elem; });
+        }
+
+        /**
+         * Passes the oldest committed element to fn(const T&) and frees its slot.
+         * \return True iff there was a committed element.
+         */
+        template<typename FN>
+        bool consume(FN fn)
+        {
+            auto pos{ __atomic_load_n(&read_position_, __ATOMIC_RELAXED) };
+            auto& s{ slots_[pos & INDEX_MASK] };
+
+            if (__atomic_load_n(&s.sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+                return false;
+            }
+
+            fn(static_cast<const T&>(s.element));
+
+            __atomic_store_n(&read_position_, pos + 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&s.sequence, pos + MAX_SIZE, __ATOMIC_RELEASE);
+
+            return true;
+        }
+
+        /// Returns true iff no committed element is waiting for the consumer.
+        bool empty() const
+        {
+            auto pos{ __atomic_load_n(&read_position_, __ATOMIC_RELAXED) };
+            return __atomic_load_n(&slots_[pos & INDEX_MASK].sequence, __ATOMIC_ACQUIRE) != pos + 1;
+        }
+    };
+
+}  // namespace cbl
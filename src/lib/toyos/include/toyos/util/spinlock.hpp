@@ -0,0 +1,77 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+namespace cbl
+{
+
+    /**
+     * A fair ticket spinlock.
+     *
+     * The lock does not disable interrupts. Code that runs in interrupt
+     * context must not take a lock that the interrupted code may hold.
+     */
+    class spinlock
+    {
+     public:
+        void lock()
+        {
+            auto ticket{ __atomic_fetch_add(&next_ticket_, 1, __ATOMIC_RELAXED) };
+            while (__atomic_load_n(&serving_, __ATOMIC_ACQUIRE) != ticket) {
+                __builtin_ia32_pause();
+            }
+        }
+
+        /// Takes the lock only if nobody holds or waits for it.
+        bool try_lock()
+        {
+            auto serving{ __atomic_load_n(&serving_, __ATOMIC_ACQUIRE) };
+            auto expected{ serving };
+            return __atomic_compare_exchange_n(&next_ticket_, &expected, serving + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+        /// Retries try_lock() up to the given number of times.
+        bool try_lock_bounded(uint64_t attempts)
+        {
+            for (uint64_t i{ 0 }; i < attempts; i++) {
+                if (try_lock()) {
+                    return true;
+                }
+                __builtin_ia32_pause();
+            }
+            return false;
+        }
+
+        void unlock()
+        {
+            __atomic_store_n(&serving_, serving_ + 1, __ATOMIC_RELEASE);
+        }
+
+        /// RAII-style lock guard
+        class guard
+        {
+         public:
+            explicit guard(spinlock& lock)
+                : lock_(lock)
+            {
+                lock_.lock();
+            }
+
+            ~guard()
+            {
+                lock_.unlock();
+            }
+
+         private:
+            spinlock& lock_;
+        };
+
+     private:
+        uint32_t next_ticket_{ 0 };
+        uint32_t serving_{ 0 };
+    };
+
+}  // namespace cbl
@@ -6,6 +6,8 @@
 #ifndef HOSTED
 // not part of standard libc
 #include <compiler.h>
+#include <toyos/panic.hpp>
+#include <toyos/printf/compiled_format.hpp>
 #endif
 #include <cstdint>
 #include <pprintpp/pprintpp.hpp>
@@ -56,10 +58,18 @@ inline constexpr const char* strip_file_path(const char* file_name)
     return shortened_name;
 }
 
-#define print_macro(level, fmtstr, ...)                                                       \
-    do {                                                                                      \
-        constexpr const char* __short_path__{ strip_file_path(__FILE__) };                    \
-        pprintf("[" #level " {s}:{}] " fmtstr "\n", __short_path__, __LINE__, ##__VA_ARGS__); \
+// Log lines are printed frequently, so outside of hosted builds, their format
+// strings are compiled into specialized code.
+#ifdef HOSTED
+#define print_pprintf pprintf
+#else
+#define print_pprintf compiled_pprintf
+#endif
+
+#define print_macro(level, fmtstr, ...)                                                             \
+    do {                                                                                            \
+        constexpr const char* __short_path__{ strip_file_path(__FILE__) };                          \
+        print_pprintf("[" #level " {s}:{}] " fmtstr "\n", __short_path__, __LINE__, ##__VA_ARGS__); \
     } while (0);
 
 #define info(fmtstr, ...) print_macro(INF, fmtstr, ##__VA_ARGS__)
@@ -91,6 +101,7 @@ inline constexpr const char* strip_file_path(const char* file_name)
 #define ASSERT(cond, fmtstr, ...)                                     \
     do {                                                              \
         if (UNLIKELY(!(cond))) {                                      \
+            begin_panic_output();                                     \
             pprintf("[%s:%d]  ", __FILE__, __LINE__);                 \
             pprintf("Assertion failed: " fmtstr "\n", ##__VA_ARGS__); \
             INTERNAL_TRAP();                                          \
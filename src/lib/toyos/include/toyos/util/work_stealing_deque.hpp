@@ -0,0 +1,134 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#include <config.hpp>
+#include <toyos/util/math.hpp>
+
+namespace cbl
+{
+
+    /**
+     * A fixed-size work-stealing deque (Chase-Lev).
+     *
+     * The owning CPU pushes and pops elements at the bottom end without
+     * contention. Any other CPU may steal elements from the top end. Owner and
+     * thieves only synchronize via a CAS on the top index when they compete
+     * for the last element.
+     *
+     * Like lock_free_queue_base, read and write positions live on separate
+     * cache lines.
+     *
+     * \tparam T        Type of the stored elements. Thieves read elements
+     *                  speculatively, so T must be trivially copyable.
+     * \tparam MAX_SIZE Maximum number of elements, must be a power of two.
+     */
+    template<class T, size_t MAX_SIZE>
+    class work_stealing_deque
+    {
+        static_assert(math::is_power_of_2(MAX_SIZE));
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        static constexpr int64_t INDEX_MASK{ MAX_SIZE - 1 };
+
+        alignas(CPU_CACHE_LINE_SIZE) int64_t top_{ 0 };
+        alignas(CPU_CACHE_LINE_SIZE) int64_t bottom_{ 0 };
+        alignas(CPU_CACHE_LINE_SIZE) std::array<T, MAX_SIZE> elements_;
+
+     public:
+        /**
+         * Adds an element at the bottom. Only the owner may call this.
+         * \return True iff there was enough space to insert the element.
+         */
+        bool push(const T& elem)
+        {
+            auto b{ __atomic_load_n(&bottom_, __ATOMIC_RELAXED) };
+            auto t{ __atomic_load_n(&top_, __ATOMIC_ACQUIRE) };
+
+            if (b - t >= static_cast<int64_t>(MAX_SIZE)) {
+                return false;
+            }
+
+            elements_[b & INDEX_MASK] = elem;
+            __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELEASE);
+
+            return true;
+        }
+
+        /**
+         * Removes the most recently pushed element. Only the owner may call this.
+         * \return nothing if the deque is empty or a thief took the last element.
+         */
+        std::optional<T> pop()
+        {
+            auto b{ __atomic_load_n(&bottom_, __ATOMIC_RELAXED) - 1 };
+            __atomic_store_n(&bottom_, b, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            auto t{ __atomic_load_n(&top_, __ATOMIC_RELAXED) };
+
+            if (t > b) {
+                __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+                return {};
+            }
+
+            T elem{ elements_[b & INDEX_MASK] };
+            if (t == b) {
+                // Last element: race against thieves for it.
+                bool won{ __atomic_compare_exchange_n(&top_, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) };
+                __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+                if (not won) {
+                    return {};
+                }
+            }
+
+            return elem;
+        }
+
+        /**
+         * Removes the oldest element. Any CPU may call this.
+         * \return nothing if the deque is empty or another CPU was faster.
+         */
+        std::optional<T> steal()
+        {
+            auto t{ __atomic_load_n(&top_, __ATOMIC_ACQUIRE) };
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            auto b{ __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE) };
+
+            if (t >= b) {
+                return {};
+            }
+
+            T elem{ elements_[t & INDEX_MASK] };
+            if (not __atomic_compare_exchange_n(&top_, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                return {};
+            }
+
+            return elem;
+        }
+
+        /**
+         * Returns the number of elements. The value is only a snapshot if
+         * other CPUs access the deque concurrently.
+         */
+        size_t size() const
+        {
+            auto b{ __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE) };
+            auto t{ __atomic_load_n(&top_, __ATOMIC_ACQUIRE) };
+            return b > t ? static_cast<size_t>(b - t) : 0;
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+    };
+
+}  // namespace cbl
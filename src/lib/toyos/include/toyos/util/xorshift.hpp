@@ -0,0 +1,35 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+namespace cbl
+{
+
+    /**
+     * \brief A small and fast pseudo random number generator
+     *
+     * Good enough to pick random victims or shuffle benchmark data, but not
+     * for anything that needs real randomness.
+     */
+    class xorshift
+    {
+     public:
+        explicit xorshift(uint64_t seed)
+            : state_(seed | 1) {}
+
+        uint64_t next()
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 7;
+            state_ ^= state_ << 17;
+            return state_;
+        }
+
+     private:
+        uint64_t state_;
+    };
+
+}  // namespace cbl
@@ -0,0 +1,65 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * A work-stealing task scheduler on top of the AP mailboxes of smp.hpp.
+ *
+ * Tasks are identified by their index and initially split into contiguous
+ * blocks, one per online CPU. A CPU that runs out of tasks steals from a
+ * random other CPU. On a host that deschedules some vCPUs, the remaining
+ * vCPUs thereby take over their work, which shows up in the steal count and
+ * the load imbalance of a run.
+ */
+namespace smp
+{
+
+    /// Maximum number of tasks that can initially be assigned to one CPU.
+    static constexpr size_t MAX_TASKS_PER_CPU{ 1024 };
+
+    struct cpu_task_stats
+    {
+        uint64_t executed{ 0 };       ///< Tasks executed by this CPU.
+        uint64_t stolen{ 0 };         ///< Tasks this CPU took from other CPUs.
+        uint64_t failed_steals{ 0 };  ///< Steal attempts that found nothing.
+        uint64_t busy_cycles{ 0 };    ///< TSC ticks spent executing tasks.
+    };
+
+    struct task_run_stats
+    {
+        std::vector<cpu_task_stats> cpus;
+        uint64_t total_cycles{ 0 };  ///< TSC ticks from start until all tasks were done.
+
+        uint64_t steals() const;
+        uint64_t failed_steals() const;
+
+        /**
+         * Returns by how many percent the busiest CPU worked longer than the
+         * average CPU. 0 means perfect balance.
+         */
+        uint64_t imbalance_percent() const;
+
+        /**
+         * Reports the steal and imbalance metrics as benchmark results whose
+         * names start with the given prefix.
+         */
+        void report(const std::string& prefix) const;
+    };
+
+    using task_fn = std::function<void(size_t task)>;
+
+    /**
+     * Executes fn(task) for every task in [0, task_count) on all CPUs.
+     *
+     * APs are started if necessary. Returns after all tasks are finished.
+     */
+    task_run_stats run_tasks(size_t task_count, const task_fn& fn);
+
+}  // namespace smp
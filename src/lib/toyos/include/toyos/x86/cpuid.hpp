@@ -11,6 +11,9 @@ enum
     CPUID_LEAF_EXTENDED_FEATURES = 0x00000007,
     CPUID_LEAF_EXTENDED_STATE = 0x0000000D,
     CPUID_LEAF_SGX_CAPABILITY = 0x00000012,
+    CPUID_LEAF_TSC_FREQUENCY = 0x00000015,
+    CPUID_LEAF_EXTENDED_MAX_LEVEL = 0x80000000,
+    CPUID_LEAF_EXTENDED_FAMILY_FEATURES = 0x80000001,
     /**
      * Base leaf for the extended CPU brand string. The full name is in this
      * leaf and the two subsequent leaves.
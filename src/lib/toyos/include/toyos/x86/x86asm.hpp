@@ -46,6 +46,15 @@ inline void outb(uint16_t port, uint8_t value)
     asm volatile("outb %%al, %%dx" ::"d"(port), "a"(value));
 }
 
+/// Writes a buffer to an I/O port with a single `rep outsb`.
+inline void outsb(uint16_t port, const void* data, size_t size)
+{
+    asm volatile("rep outsb"
+                 : "+S"(data), "+c"(size)
+                 : "d"(port)
+                 : "memory");
+}
+
 inline uint16_t inw(uint16_t port)
 {
     unsigned value;
@@ -181,6 +190,14 @@ inline void invlpg(uintptr_t lin_addr)
                  : "memory");
 }
 
+inline void wbinvd()
+{
+    asm volatile("wbinvd"
+                 :
+                 :
+                 : "memory");
+}
+
 inline bool interrupts_enabled()
 {
     uint64_t flags;
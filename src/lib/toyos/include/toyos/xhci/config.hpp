@@ -38,8 +38,9 @@ static constexpr size_t MAX_PACKET_SIZE{ 1024 };
 // Each transfer request can hold up to this many bytes.
 // For input, we don't expect large requests, so 1 KiB should be enough.
 static constexpr size_t IN_BUF_SIZE{ MAX_PACKET_SIZE };
-// For output, we want to transfer as much as possible.
-static constexpr size_t OUT_BUF_SIZE{ 64 * 1024 };
+// For output, we keep several smaller transfers in flight instead of a
+// single large one.
+static constexpr size_t OUT_BUF_SIZE{ 16 * 1024 };
 // Note that the maximum is actually 64 KiB - 1, because the length
 // field is only 16 bits.
 static constexpr size_t TRANSFER_MAX{ 64 * 1024 - 1 };
@@ -47,10 +48,26 @@ static constexpr size_t TRANSFER_MAX{ 64 * 1024 - 1 };
 // Requests (or events) are managed in ring buffers with this many entries.
 static constexpr size_t EVENT_RING_SIZE{ 16 };
 static constexpr size_t IN_RING_SIZE{ 16 };
-// Currently, scheduling multiple transfers at a time hangs
-// the controller. We don't need a large ring because
-// we always wait for the previous transfer to be completed.
-static constexpr size_t OUT_RING_SIZE{ 4 };
+// Output transfers are pipelined. One entry is taken by the Link TRB and
+// one must stay free to tell a full ring from an empty one.
+static constexpr size_t OUT_RING_SIZE{ 16 };
+static constexpr size_t MAX_OUTSTANDING_TRANSFERS{ OUT_RING_SIZE - 2 };
+
+// Output is staged directly in the DMA buffer. One staging slot is filled
+// while the others may still be in flight.
+static constexpr size_t OUT_STAGING_SLOTS{ MAX_OUTSTANDING_TRANSFERS + 1 };
+
+// Output transfers start out serialized. Once this many transfers completed
+// one at a time, the controller is trusted with several at once.
+static constexpr size_t PIPELINE_PROBE_TRANSFERS{ 16 };
+
+// If no output transfer completes for this long while several are in flight,
+// we assume the controller can't handle pipelining and serialize transfers.
+static constexpr std::chrono::milliseconds DELAY_PIPELINE_STALL{ 100 };
+
+// If no output transfer completes for this long, the debug host is assumed to
+// not read. Output is dropped until a transfer completes again.
+static constexpr std::chrono::seconds DELAY_OUTPUT_STALL{ 1 };
 
 // All rings and transfer buffers need to be accessible via DMA.
 // These constants provide shortcuts to size calculations when
@@ -71,3 +88,5 @@ static_assert(OUT_RING_PAGES * PAGE_SIZE >= OUT_RING_SIZE * sizeof(trb), "Not en
 
 static_assert(IN_BUF_PAGES * PAGE_SIZE >= IN_BUF_SIZE * IN_RING_SIZE, "Not enough space for input buffer");
 static_assert(OUT_BUF_PAGES * PAGE_SIZE >= OUT_BUF_SIZE * OUT_RING_SIZE, "Not enough space for output buffer");
+static_assert(OUT_STAGING_SLOTS <= OUT_RING_SIZE, "Not enough space for staging slots");
+static_assert(OUT_BUF_SIZE <= TRANSFER_MAX, "Staging slot exceeds the maximum transfer size");
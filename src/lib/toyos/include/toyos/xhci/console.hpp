@@ -41,7 +41,13 @@ class xhci_console_base : public console
 
     virtual void putc(char c) override;
 
+    virtual void write(const char* data, size_t size) override;
+
     static void putchar(unsigned char c);
+    static void write_buffer(const char* data, size_t size);
+
+    /// Returns true iff an xHCI console was initialized with xhci_console_init().
+    static bool is_active();
 
     /**
      * Do queue maintenance and re-connect if the connection was lost.
@@ -5,6 +5,8 @@
 
 #include "toyos/util/lock_free_queue.hpp"
 
+#include <algorithm>
+
 #include "config.hpp"
 #include "debug_capability.hpp"
 #include "debug_structs.hpp"
@@ -77,6 +79,13 @@ class xhci_debug_device : public xhci_device
      */
     void write_byte(unsigned char c);
 
+    /**
+     * Write a sequence of bytes to the output buffer.
+     *
+     * Every time the buffer is full, it is flushed.
+     */
+    void write(const char* data, size_t size);
+
     /**
      * Write a string.
      *
@@ -88,6 +97,24 @@ class xhci_debug_device : public xhci_device
     /// Flush the output buffer to the bus.
     void flush();
 
+    /**
+     * Limit the number of output transfers that are in flight at once.
+     *
+     * A value of 1 serializes all transfers. This happens automatically if
+     * the controller stalls with multiple outstanding transfers. Pipelining
+     * only starts after PIPELINE_PROBE_TRANSFERS transfers completed.
+     */
+    void set_max_outstanding_transfers(size_t max)
+    {
+        pipeline_limit_ = std::clamp(max, size_t(1), MAX_OUTSTANDING_TRANSFERS);
+        max_outstanding_ = std::min(max_outstanding_, pipeline_limit_);
+    }
+
+    size_t max_outstanding_transfers() const
+    {
+        return max_outstanding_;
+    }
+
  private:
     uintptr_t get_info_context_addr() const
     {
@@ -100,7 +127,16 @@ class xhci_debug_device : public xhci_device
     void setup_endpoint_contexts();
     void setup_event_ring();
 
-    void queue_write_transfer(const std::string& str);
+    /// Queues a transfer of a staging slot. Returns false if the output was dropped.
+    bool queue_write_transfer(size_t slot, size_t length);
+
+    /// Takes note of a completed output transfer.
+    void out_transfer_completed();
+
+    char* staging_slot(size_t slot) const
+    {
+        return static_cast<char*>(out_data_buffer_.lin_addr) + slot * OUT_BUF_SIZE;
+    }
 
     dbc_capability* dbc_cap_{ *find_cap<dbc_capability>() };
 
@@ -136,7 +172,25 @@ class xhci_debug_device : public xhci_device
                                        out_ring_buffer_.dma_addr };
     trb_ring<IN_RING_SIZE> in_ring_{ *static_cast<in_buf_type*>(in_ring_buffer_.lin_addr), in_ring_buffer_.dma_addr };
 
-    std::string output_buffer_;
+    // The output buffer is the staging slot in out_data_buffer_ that is
+    // currently being filled. Flushing hands it to the controller as is.
+    size_t staging_slot_{ 0 };
+    size_t staging_length_{ 0 };
+
+    // Output transfers that were queued but not yet reported as completed
+    size_t outstanding_transfers_{ 0 };
+
+    // The transfers that may currently be in flight and the limit that
+    // applies once pipelining is enabled
+    size_t max_outstanding_{ 1 };
+    size_t pipeline_limit_{ MAX_OUTSTANDING_TRANSFERS };
+
+    // Transfers that completed while they were serialized
+    size_t serialized_completions_{ 0 };
+
+    // Set when no transfer completed for DELAY_OUTPUT_STALL. Output is dropped
+    // until the next completion.
+    bool output_stalled_{ false };
 
     using mutex = device_driver_adapter::mutex_interface;
     std::unique_ptr<mutex> poll_mtx_;
@@ -6,7 +6,14 @@
 #include <toyos/boot.hpp>
 #include <toyos/boot_cmdline.hpp>
 #include <toyos/cmdline.hpp>
+#include <toyos/console/console_memory.hpp>
+#include <toyos/per_cpu.hpp>
+#include <toyos/printf/backend.hpp>
+#include <toyos/smp.hpp>
 #include <toyos/util/cpuid.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+#include <string>
 
 void __attribute__((weak)) prologue()
 {}
@@ -34,10 +41,12 @@ void print_environment_info()
 namespace baretest
 {
 
+    // Test cases on different CPUs need their own jump target for failures.
+    static per_cpu<jmp_buf> env;
+
     jmp_buf& get_env()
     {
-        static jmp_buf env;
-        return env;
+        return env.local();
     }
 
     test_suite& get_suite()
@@ -48,7 +57,11 @@ namespace baretest
 
     bool test_case::run() const
     {
-        result_t res = fn_();
+        return report(fn_());
+    }
+
+    bool test_case::report(result_t res) const
+    {
         switch (res) {
             case result_t::SUCCESS:
                 success(name);
@@ -64,21 +77,91 @@ namespace baretest
         }
     }
 
-    test_case::test_case(test_suite& suite, const char* name_, test_case_fn tc)
-        : name(name_), fn_(tc)
+    test_case::test_case(test_suite& suite, const char* name_, test_case_fn tc, bool cpu_local_)
+        : name(name_), fn_(tc), cpu_local(cpu_local_)
     {
         suite.add(*this);
     }
 
+    static bool parallel_testcases_enabled()
+    {
+        auto cmdline = get_boot_cmdline().value_or("");
+        return cmdline::cmdline_parser(cmdline).parallel_testcases_option();
+    }
+
     void test_suite::run()
     {
+        // APs have to be online before the test count is announced, because
+        // starting them prints to the console.
+        bool parallel{ parallel_testcases_enabled() and smp::start_aps() > 1 };
+
         hello(test_cases.size());
-        for (const auto& tc : test_cases) {
-            tc.run();
+        for (size_t i{ 0 }; i < test_cases.size();) {
+            if (not parallel or not test_cases[i].cpu_local) {
+                test_cases[i++].run();
+                continue;
+            }
+
+            auto last{ i };
+            while (last < test_cases.size() and test_cases[last].cpu_local) {
+                last++;
+            }
+
+            run_parallel(i, last);
+            i = last;
         }
         goodbye();
     }
 
+    void test_suite::run_parallel(size_t first, size_t last)
+    {
+        struct parallel_result
+        {
+            std::string output;
+            test_case::result_t result;
+            bool done{ false };
+        };
+
+        std::vector<parallel_result> results(last - first);
+        size_t next{ first };
+
+        auto worker = [&] {
+            while (true) {
+                auto idx{ __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED) };
+                if (idx >= last) {
+                    return;
+                }
+
+                auto& res{ results[idx - first] };
+                capture_printf_output(&res.output);
+                res.result = test_cases[idx].fn_();
+                capture_printf_output(nullptr);
+
+                __atomic_store_n(&res.done, true, __ATOMIC_RELEASE);
+            }
+        };
+
+        for (size_t cpu{ 1 }; cpu < online_cpus(); cpu++) {
+            smp::run_on_cpu_async(cpu, worker);
+        }
+
+        // Report in declaration order, so the output looks like that of a
+        // sequential run.
+        for (size_t idx{ first }; idx < last; idx++) {
+            auto& res{ results[idx - first] };
+            while (not __atomic_load_n(&res.done, __ATOMIC_ACQUIRE)) {
+                cpu_pause();
+            }
+
+            print_to_backends(res.output);
+            test_cases[idx].report(res.result);
+        }
+
+        for (size_t cpu{ 1 }; cpu < online_cpus(); cpu++) {
+            smp::wait_for_cpu(cpu);
+        }
+    }
+
     __attribute__((noreturn)) void fail(const char* msg, ...)
     {
         va_list args;
@@ -98,4 +181,14 @@ namespace baretest
         return name_found || name_with_test_prefix_found;
     }
 
+    void pause_console()
+    {
+        memory_console::pause();
+    }
+
+    void resume_console()
+    {
+        memory_console::resume();
+    }
+
 }  // namespace baretest
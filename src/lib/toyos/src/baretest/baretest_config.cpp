@@ -2,6 +2,8 @@
 //
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <toyos/binary_trace.hpp>
+#include <toyos/console/console_memory.hpp>
 #include <toyos/util/baretest_config.hpp>
 #include <toyos/util/sotest.hpp>
 
@@ -10,14 +12,19 @@ namespace baretest
     void success(const char* name)
     {
         test_protocol::success(name);
+        memory_console::flush();
     }
     void failure(const char* name)
     {
+        // The trace leading to the failure is printed before the verdict.
+        binary_trace::dump();
         test_protocol::fail(name);
+        memory_console::flush();
     }
     void skip()
     {
         test_protocol::skip();
+        memory_console::flush();
     }
     void hello(size_t test_count)
     {
@@ -25,6 +32,8 @@ namespace baretest
     }
     void goodbye()
     {
+        binary_trace::dump();
+        memory_console::resume();
         test_protocol::end();
     }
 
@@ -0,0 +1,100 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <toyos/binary_trace.hpp>
+
+#include <algorithm>
+#include <limits>
+
+per_cpu<binary_trace::ring*> binary_trace::rings{ nullptr };
+per_cpu<uint64_t> binary_trace::dropped{ 0 };
+
+void binary_trace::prepare()
+{
+    rings.for_each_online([](size_t, ring*& r) {
+        if (r == nullptr) {
+            r = new ring{};
+        }
+    });
+}
+
+void binary_trace::dump()
+{
+    struct cursor
+    {
+        uint64_t next;
+        uint64_t head;
+    };
+
+    std::array<cursor, MAX_CPUS> cursors{};
+    uint64_t lost{ 0 };
+    uint64_t unprepared{ 0 };
+
+    dropped.for_each_online([&](size_t, uint64_t& count) {
+        unprepared += count;
+        count = 0;
+    });
+
+    if (unprepared != 0) {
+        printf("Deferred trace: %lu records dropped, binary_trace::prepare() was not called\n", unprepared);
+    }
+    uint64_t first_tsc{ std::numeric_limits<uint64_t>::max() };
+
+    rings.for_each_online([&](size_t cpu, const ring* cpu_ring) {
+        if (cpu_ring == nullptr) {
+            return;
+        }
+
+        const auto& r{ *cpu_ring };
+        auto oldest{ r.head > RING_RECORDS ? r.head - RING_RECORDS : 0 };
+        cursors[cpu] = { oldest, r.head };
+        lost += oldest;
+
+        if (oldest != r.head) {
+            first_tsc = std::min(first_tsc, r.records[oldest % RING_RECORDS].tsc);
+        }
+    });
+
+    if (first_tsc == std::numeric_limits<uint64_t>::max()) {
+        return;
+    }
+
+    printf("Deferred trace (TSC relative to %#lx):\n", first_tsc);
+    if (lost != 0) {
+        printf("  %lu older records were overwritten\n", lost);
+    }
+
+    // Merge the per-CPU rings by their timestamps.
+    while (true) {
+        const record* oldest{ nullptr };
+        size_t oldest_cpu{ 0 };
+
+        for (size_t cpu{ 0 }; cpu < online_cpus(); cpu++) {
+            auto& c{ cursors[cpu] };
+            if (c.next == c.head) {
+                continue;
+            }
+
+            const auto& rec{ rings[cpu]->records[c.next % RING_RECORDS] };
+            if (oldest == nullptr or rec.tsc < oldest->tsc) {
+                oldest = &rec;
+                oldest_cpu = cpu;
+            }
+        }
+
+        if (oldest == nullptr) {
+            break;
+        }
+
+        printf("  %2lu +%-10lu ", oldest_cpu, oldest->tsc - first_tsc);
+        oldest->replay(*oldest);
+        cursors[oldest_cpu].next++;
+    }
+
+    rings.for_each_online([](size_t, ring* r) {
+        if (r != nullptr) {
+            r->head = 0;
+        }
+    });
+}
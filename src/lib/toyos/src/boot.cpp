@@ -17,16 +17,27 @@
 #include <toyos/console/console_debugcon.hpp>
 #include <toyos/console/console_serial.hpp>
 #include <toyos/console/console_serial_util.hpp>
+#include <toyos/console/console_virtio.hpp>
 #include <toyos/console/xhci_console.hpp>
+#include <toyos/irq_guard.hpp>
 #include <toyos/memory/buddy.hpp>
+#include <toyos/memory/growable_heap.hpp>
+#include <toyos/memory/intrusive_block_manager.hpp>
 #include <toyos/memory/simple_buddy.hpp>
+#include <toyos/memory/slab.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/memory/tlsf_heap.hpp>
 #include <toyos/multiboot/multiboot.hpp>
 #include <toyos/multiboot2/multiboot2.hpp>
+#include <toyos/page_pool.hpp>
+#include <toyos/panic.hpp>
 #include <toyos/pci/bus.hpp>
 #include <toyos/testhelper/lapic_test_tools.hpp>
 #include <toyos/testhelper/pic.hpp>
 #include <toyos/util/cpuid.hpp>
 #include <toyos/util/interval.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/spinlock.hpp>
 #include <toyos/x86/arch.hpp>
 #include <toyos/x86/segmentation.hpp>
 #include <toyos/xen-pvh.hpp>
@@ -39,13 +50,90 @@ extern int main();
 extern uint64_t gdt_start asm("gdt");
 extern uint64_t gdt_tss;
 
-first_fit_heap<HEAP_ALIGNMENT>* current_heap{ nullptr };
+// The TLSF heap bounds the time of every allocation, which keeps heap
+// operations from skewing timing-sensitive tests. The first-fit heap stays the
+// default.
+#ifdef TOYOS_TLSF_HEAP
+using heap_t = tlsf_heap<HEAP_ALIGNMENT>;
+#else
+using heap_t = first_fit_heap<HEAP_ALIGNMENT>;
+#endif
+
+// The heap starts in a static region, because it is needed before the boot
+// information is parsed. Later, it grows with memory from the physical memory
+// pool.
+growable_heap<heap_t, fixed_memory>* current_heap{ nullptr };
 simple_buddy* aligned_heap{ nullptr };
 
+// Serializes heap accesses once APs are running.
+static cbl::spinlock heap_lock;
+
+// How often a panicking CPU tries to get the heap lock before it gives up.
+static constexpr uint64_t PANIC_LOCK_ATTEMPTS{ 1'000'000 };
+
+/**
+ * Takes the heap lock with interrupts disabled, so an interrupt handler that
+ * allocates cannot deadlock with the code it interrupted.
+ *
+ * During a panic, the lock may be held by the panicking CPU, so it is only
+ * tried for a while.
+ */
+class heap_guard
+{
+ public:
+    heap_guard()
+    {
+        if (panic_in_progress()) {
+            locked_ = heap_lock.try_lock_bounded(PANIC_LOCK_ATTEMPTS);
+        }
+        else {
+            heap_lock.lock();
+            locked_ = true;
+        }
+    }
+
+    ~heap_guard()
+    {
+        if (locked_) {
+            heap_lock.unlock();
+        }
+    }
+
+ private:
+    irq_guard irqs_;
+    bool locked_{ false };
+};
+
+// Small objects come from slab caches whose pages are taken from a page pool
+// of their own. It must not allocate from the heap itself.
+static constexpr size_t SLAB_POOL_SIZE{ 0x100000 };
+alignas(PAGE_SIZE) static char slab_pool_data[SLAB_POOL_SIZE];
+using slab_page_pool = page_pool_impl<intrusive_block_manager<math::order_envelope(SLAB_POOL_SIZE), PAGE_BITS>>;
+static slab_allocator* small_objects{ nullptr };
+
 static constexpr size_t DMA_POOL_SIZE{ 0x100000 };
 alignas(PAGE_SIZE) static char dma_pool_data[DMA_POOL_SIZE];
 alignas(PAGE_SIZE) static x86::tss tss;  // alignment only used to avoid crossing page boundaries
-static buddy dma_pool{ 32 };
+
+// The DMA pool manages page numbers and never has to allocate itself.
+using dma_block_manager = intrusive_block_manager<math::order_envelope(DMA_POOL_SIZE / PAGE_SIZE), 0, PAGE_BITS>;
+static buddy_impl<dma_block_manager> dma_pool{ 32, addr2pn(uintptr_t(dma_pool_data)) };
+static cbl::spinlock dma_pool_lock;
+
+// Usable RAM outside of the image, as reported by the boot loader. Free blocks
+// store their list nodes in the memory itself, so all of it has to be
+// identity mapped.
+using phys_page_pool = page_pool_impl<intrusive_block_manager<math::order_max(IDENTITY_MAPPED_LIMIT), PAGE_BITS>, math::order_max(1_GiB)>;
+static cbl::spinlock phys_pool_lock;
+static uint64_t phys_free_bytes{ 0 };
+
+static memory_map boot_mem_map;
+
+// The heap grows in chunks of at least this order.
+static constexpr math::order_t HEAP_GROW_ORDER{ math::order_max(2_MiB) };
+
+/// Marks the end of the loaded image, see kernel.lds.
+extern char IMAGE_END[];
 
 std::optional<boot_method> current_boot_method = std::nullopt;
 
@@ -64,21 +152,121 @@ std::string_view boot_method_name(boot_method method)
 
 cbl::interval allocate_dma_mem(size_t ord)
 {
+    cbl::spinlock::guard _{ dma_pool_lock };
     auto begin = dma_pool.alloc(ord);
-    ASSERT(begin, "not enough DMA memory");
+    if (not begin) {
+        // The physical memory pool only holds memory below 4 GiB, so it is
+        // fine for DMA as well.
+        auto mem{ alloc_phys(ord + PAGE_BITS) };
+        ASSERT(mem, "not enough DMA memory");
+        begin = addr2pn(uintptr_t(*mem));
+    }
 
     return cbl::interval::from_order(*begin, ord);
 }
 
+const memory_map& boot_memory_map()
+{
+    return boot_mem_map;
+}
+
+// The pool is created on first use, because the heap may already grow while
+// the global constructors run.
+static phys_page_pool& phys_pool()
+{
+    static phys_page_pool pool{ 0 };
+    return pool;
+}
+
+std::optional<phy_addr_t> alloc_phys(math::order_t order)
+{
+    cbl::spinlock::guard _{ phys_pool_lock };
+    auto addr{ phys_pool().try_alloc_order(order) };
+    if (addr) {
+        phys_free_bytes -= uint64_t(1) << order;
+    }
+    return addr;
+}
+
+void free_phys(phy_addr_t addr, math::order_t order)
+{
+    cbl::spinlock::guard _{ phys_pool_lock };
+    phys_pool().free_order(addr, order);
+    phys_free_bytes += uint64_t(1) << order;
+}
+
+uint64_t free_phys_bytes()
+{
+    cbl::spinlock::guard _{ phys_pool_lock };
+    return phys_free_bytes;
+}
+
+/**
+ * Hands the usable RAM of the boot memory map to the physical memory pool.
+ *
+ * Low memory, the image and memory that is not identity mapped are left out.
+ * The boot information structures must not be used after this.
+ */
+static void initialize_phys_pool()
+{
+    static constexpr uint64_t LOW_MEMORY_END{ 1_MiB };
+
+    const std::array<cbl::interval, 2> available{ {
+        { LOW_MEMORY_END, load_addr() },
+        { math::align_up(ptr_to_num(IMAGE_END), PAGE_BITS), IDENTITY_MAPPED_LIMIT },
+    } };
+
+    cbl::spinlock::guard _{ phys_pool_lock };
+    for (const auto& region : boot_mem_map) {
+        if (region.type != memory_type::USABLE) {
+            continue;
+        }
+
+        for (const auto& ival : available) {
+            auto usable{ region.range.intersection(ival) };
+            auto pages{ cbl::interval(math::align_up(usable.a, PAGE_BITS), math::align_down(usable.b, PAGE_BITS)) };
+            if (not pages.empty()) {
+                phys_pool().add_range(pages);
+                phys_free_bytes += pages.size();
+            }
+        }
+    }
+}
+
+/// Provides fresh memory to the heap.
+static cbl::interval grow_heap(size_t min_size)
+{
+    auto order{ std::max<math::order_t>(HEAP_GROW_ORDER, math::order_envelope(min_size)) };
+    auto mem{ alloc_phys(order) };
+    return mem ? cbl::interval::from_order(uintptr_t(*mem), order) : cbl::interval{};
+}
+
 EXTERN_C void init_heap()
 {
     static constexpr unsigned HEAP_SIZE{ 1 /* MiB */ * 1024 * 1024 };
     alignas(CPU_CACHE_LINE_SIZE) static char heap_data[HEAP_SIZE];
-    static fixed_memory heap_mem(size_t(heap_data), HEAP_SIZE);
-    static first_fit_heap<HEAP_ALIGNMENT> heap(heap_mem);
+    static growable_heap<heap_t, fixed_memory> heap{ grow_heap };
+    heap.add_region(size_t(heap_data), HEAP_SIZE);
     current_heap = &heap;
     static simple_buddy align_buddy{ 31 + math::order_max(HEAP_ALIGNMENT) };
     aligned_heap = &align_buddy;
+
+    static slab_page_pool slab_pages{ ptr_to_num(slab_pool_data) };
+    for (size_t offset{ 0 }; offset < SLAB_POOL_SIZE; offset += PAGE_SIZE) {
+        slab_pages.free(phy_addr_t(ptr_to_num(slab_pool_data) + offset));
+    }
+
+    static slab_allocator slabs{ [] {
+        auto page{ slab_pages.try_alloc() };
+        return page ? num_to_ptr<void>(uintptr_t(*page)) : nullptr;
+    } };
+    small_objects = &slabs;
+}
+
+const slab_allocator& small_object_allocator()
+{
+    ASSERT(small_objects, "heap not initialized");
+    return *small_objects;
 }
 
 /**
@@ -160,6 +348,26 @@ static void initialize_console(const std::string& cmdline, acpi_mcfg* mcfg)
             xhci_console_init(xhci_cons);
         }
     }
+    else if (p.virtio_console_option()) {
+        PANIC_UNLESS(mcfg, "No valid MCFG pointer given!");
+
+        pci_bus pcibus(phy_addr_t(mcfg->base), mcfg->busses());
+        auto virtio_pci_dev = std::find_if(pcibus.begin(), pcibus.end(), console_virtio::is_virtio_console);
+
+        if (virtio_pci_dev != pcibus.end()) {
+            auto dma_region = pn2addr(allocate_dma_mem(math::order_envelope(console_virtio::DMA_PAGES)));
+
+            static console_virtio virtio_cons(*virtio_pci_dev, dma_region);
+            if (virtio_cons.ready()) {
+                virtio_console_init(virtio_cons);
+            }
+        }
+
+        // Without a working device, we still want to see what is going on.
+        if (not console_virtio::is_active()) {
+            serial_init(discover_serial_port(mcfg));
+        }
+    }
     else {
         serial_init(discover_serial_port(mcfg));
     }
@@ -245,13 +453,16 @@ EXTERN_C void entry64(uint32_t magic, uintptr_t boot_info)
         current_boot_method = boot_method::XEN_PVH;
         const auto* info = reinterpret_cast<xen_pvh::hvm_start_info*>(boot_info);
         cmdline = reinterpret_cast<const char*>(info->cmdline_paddr);
+        boot_mem_map.add_xen_pvh(*info);
 
         const auto rsdp{ reinterpret_cast<const acpi_rsdp*>(info->rsdp_paddr) };
         mcfg = find_mcfg(rsdp);
     }
     else if (magic == multiboot::multiboot_module::MAGIC_LDR) {
         current_boot_method = boot_method::MULTIBOOT1;
-        cmdline = reinterpret_cast<multiboot::multiboot_info*>(boot_info)->get_cmdline().value_or("");
+        const auto* mbi{ reinterpret_cast<multiboot::multiboot_info*>(boot_info) };
+        cmdline = mbi->get_cmdline().value_or("");
+        boot_mem_map.add_multiboot1(*mbi);
 
         // On legacy systems (where we use Multiboot1), the ACPI tables can be
         // found with the legacy way (see find_mcfg()).
@@ -260,6 +471,7 @@ EXTERN_C void entry64(uint32_t magic, uintptr_t boot_info)
     else if (magic == multiboot2::MB2_MAGIC) {
         current_boot_method = boot_method::MULTIBOOT2;
         auto reader{ multiboot2::mbi2_reader(reinterpret_cast<const uint8_t*>(boot_info)) };
+        boot_mem_map.add_multiboot2(reader);
         const auto cmdline_tag{ reader.find_tag(multiboot2::mbi2_cmdline::TYPE) };
 
         if (cmdline_tag) {
@@ -288,6 +500,8 @@ EXTERN_C void entry64(uint32_t magic, uintptr_t boot_info)
         __builtin_trap();
     }
 
+    initialize_phys_pool();
+
     boot_cmdline = cmdline;
     initialize_console(cmdline, mcfg);
 
@@ -296,10 +510,31 @@ EXTERN_C void entry64(uint32_t magic, uintptr_t boot_info)
     shutdown();
 }
 
+/// Allocates from the slab caches if possible and from the heap otherwise.
+static void* heap_alloc(size_t size)
+{
+    if (size <= slab_allocator::MAX_SIZE) {
+        if (auto* obj{ small_objects->alloc(size) }; obj != nullptr) {
+            return obj;
+        }
+    }
+    return current_heap->alloc(size);
+}
+
+static void heap_free(void* p)
+{
+    if (cbl::interval::from_size(ptr_to_num(slab_pool_data), SLAB_POOL_SIZE).contains(ptr_to_num(p))) {
+        slab_allocator::free(p);
+        return;
+    }
+    current_heap->free(p);
+}
+
 void* operator new(size_t size)
 {
     ASSERT(current_heap, "heap not initialized");
-    auto tmp{ current_heap->alloc(size) };
+    heap_guard _;
+    auto tmp{ heap_alloc(size) };
     ASSERT(tmp, "out of memory");
     return tmp;
 }
@@ -308,8 +543,9 @@ void* operator new(size_t size, std::align_val_t alignment)  // C++17, nodiscard
 {
     // use default heap if possible
     ASSERT(current_heap, "heap not initialized");
+    heap_guard _;
     if (alignment <= static_cast<std::align_val_t>(current_heap->alignment())) {
-        return current_heap->alloc(size);
+        return heap_alloc(size);
     }
 
     ASSERT(aligned_heap, "aligned heap not initialized");
@@ -358,15 +594,17 @@ void* operator new[](size_t size, std::align_val_t alignment,
 void operator delete(void* p) noexcept
 {
     ASSERT(current_heap, "heap not initialized");
-    current_heap->free(p);
+    heap_guard _;
+    heap_free(p);
 }
 
 void operator delete(void* p, std::align_val_t alignment) noexcept  // C++17
 {
     // use default heap if possible
     ASSERT(current_heap, "heap not initialized");
+    heap_guard _;
     if (alignment <= static_cast<std::align_val_t>(current_heap->alignment())) {
-        return current_heap->free(p);
+        return heap_free(p);
     }
 
     ASSERT(aligned_heap, "aligned heap not initialized");
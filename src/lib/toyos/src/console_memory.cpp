@@ -0,0 +1,109 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <toyos/console/console_memory.hpp>
+#include <toyos/printf/backend.hpp>
+#include <toyos/util/byte_ring.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+namespace memory_console
+{
+
+    // Backends are only called by one CPU at a time and with interrupts
+    // disabled, so the ring has a single producer.
+    static cbl::byte_ring<CAPACITY> ring;
+
+    // The real consoles while output is paused
+    static printf_backend_list saved_backends;
+    static bool is_paused{ false };
+
+    static uint64_t total_dropped{ 0 };
+
+    /// Writes the captured output to the currently registered backends.
+    static void replay()
+    {
+        auto dropped{ ring.dropped() };
+
+        // After an overflow, the oldest line is incomplete.
+        bool skip_partial_line{ dropped != 0 };
+        ring.drain([&](const char* data, size_t size) {
+            if (skip_partial_line) {
+                auto* newline{ static_cast<const char*>(memchr(data, '\n', size)) };
+                auto skipped{ newline != nullptr ? static_cast<size_t>(newline - data) + 1 : size };
+
+                dropped += skipped;
+                data += skipped;
+                size -= skipped;
+                skip_partial_line = newline == nullptr;
+            }
+
+            if (size != 0) {
+                write_printf_output(data, size);
+            }
+        });
+
+        total_dropped += dropped;
+        if (dropped != 0) {
+            printf("memory console: %llu bytes of output were dropped\n", static_cast<unsigned long long>(dropped));
+        }
+
+        flush_printf_output();
+    }
+
+    void pause()
+    {
+        if (is_paused) {
+            return;
+        }
+
+        flush_printf_output();
+        saved_backends = exchange_printf_backends({ { { putchar, write_buffer } } });
+        is_paused = true;
+    }
+
+    void resume()
+    {
+        if (not is_paused) {
+            return;
+        }
+
+        flush_printf_output();
+        exchange_printf_backends(saved_backends);
+        is_paused = false;
+
+        replay();
+    }
+
+    void flush()
+    {
+        if (is_paused) {
+            resume();
+            pause();
+        }
+    }
+
+    bool paused()
+    {
+        return is_paused;
+    }
+
+    uint64_t dropped_bytes()
+    {
+        return total_dropped + ring.dropped();
+    }
+
+    void putchar(unsigned char c)
+    {
+        auto ch{ static_cast<char>(c) };
+        ring.write(&ch, 1);
+    }
+
+    void write_buffer(const char* data, size_t size)
+    {
+        ring.write(data, size);
+    }
+
+}  // namespace memory_console
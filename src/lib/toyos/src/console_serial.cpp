@@ -4,19 +4,102 @@
 
 #include <toyos/console/console_serial.hpp>
 #include <toyos/printf/backend.hpp>
+#include <toyos/testhelper/int_guard.hpp>
 #include <toyos/x86/x86asm.hpp>
 
-static console* active_console{ nullptr };
+static console_serial* active_console{ nullptr };
 
-void console_serial_base::putc(char c)
+bool console_serial_base::wait_for_thb_empty()
 {
     unsigned retry_count{ 100000 };
     while (not(inb(base + LSR) & THB_EMPTY)) {
         if (not --retry_count) {
-            return;
+            return false;
+        }
+    }
+    return true;
+}
+
+void console_serial_base::putc(char c)
+{
+    if (tx_irq_mode_) {
+        write(&c, 1);
+        return;
+    }
+
+    if (wait_for_thb_empty()) {
+        outb(base + THB, c);
+    }
+}
+
+void console_serial_base::write(const char* data, size_t size)
+{
+    if (not tx_irq_mode_) {
+        // With FIFOs enabled, THB_EMPTY signals an empty FIFO.
+        for (size_t pos{ 0 }; pos < size;) {
+            if (not wait_for_thb_empty()) {
+                return;
+            }
+
+            for (size_t end{ std::min(size, pos + fifo_depth_) }; pos < end; pos++) {
+                outb(base + THB, data[pos]);
+            }
+        }
+        return;
+    }
+
+    // The interrupt handler consumes from the ring as well.
+    int_guard _;
+
+    for (size_t pos{ 0 }; pos < size; pos++) {
+        while (not tx_ring_.push(data[pos])) {
+            // The ring is full, so make room by polling.
+            if (not wait_for_thb_empty()) {
+                return;
+            }
+            fill_fifo_from_ring();
         }
     }
-    outb(base + THB, c);
+
+    // If the transmitter is idle, there won't be a THRE interrupt to start
+    // the transfer.
+    if (inb(base + LSR) & THB_EMPTY) {
+        fill_fifo_from_ring();
+    }
+}
+
+void console_serial_base::fill_fifo_from_ring()
+{
+    for (size_t i{ 0 }; i < fifo_depth_ and not tx_ring_.empty(); i++) {
+        outb(base + THB, tx_ring_.front());
+        tx_ring_.pop();
+    }
+}
+
+void console_serial_base::set_tx_irq_mode(bool enabled)
+{
+    int_guard _;
+
+    if (enabled) {
+        tx_irq_mode_ = true;
+        outb(base + MCR, inb(base + MCR) | MCR_IRQ);
+        outb(base + IER, inb(base + IER) | IER_SEND);
+        return;
+    }
+
+    outb(base + IER, inb(base + IER) & ~IER_SEND);
+    while (not tx_ring_.empty() and wait_for_thb_empty()) {
+        fill_fifo_from_ring();
+    }
+    tx_irq_mode_ = false;
+}
+
+void console_serial_base::handle_irq()
+{
+    // Reading IIR acknowledges a pending THRE interrupt.
+    if ((inb(base + IIR) & IIR_ID_MASK) == IIR_SEND) {
+        fill_fifo_from_ring();
+    }
 }
 
 console_serial_base::console_serial_base(uint16_t port, unsigned baud)
@@ -30,6 +113,11 @@ console_serial_base::console_serial_base(uint16_t port, unsigned baud)
     outb(base + FCR, FCR_ENABLE | FCR_CLEAR);  // clear and enable FIFOs
     outb(base + MCR, MCR_DTR | MCR_RTS);       // make RTS and DTR active
 
+    // Only a 16550A reports both FIFO bits after enabling the FIFOs.
+    if ((inb(base + IIR) & IIR_FIFO_ENABLED) == IIR_FIFO_ENABLED) {
+        fifo_depth_ = FIFO_DEPTH_16550A;
+    }
+
     // On some serial controllers this sequence can lead to a desynchronization
     // with the receiver, in which case the receiver goes into break state.
     // If we continue sending data immediately, the next couple frames can be
@@ -52,9 +140,26 @@ void console_serial::putchar(unsigned char c)
     }
 }
 
+void console_serial::write_buffer(const char* data, size_t size)
+{
+    if (active_console) {
+        active_console->write(data, size);
+    }
+}
+
+bool console_serial::is_active()
+{
+    return active_console != nullptr;
+}
+
+console_serial* console_serial::active()
+{
+    return active_console;
+}
+
 void serial_init(uint16_t port_begin)
 {
     static console_serial cons(port_begin, SERIAL_BAUD);
     active_console = &cons;
-    add_printf_backend(console_serial::putchar);
+    add_printf_backend(console_serial::putchar, console_serial::write_buffer);
 }
@@ -0,0 +1,300 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <toyos/console/console_virtio.hpp>
+#include <toyos/printf/backend.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+static console_virtio* active_console{ nullptr };
+
+namespace
+{
+    enum
+    {
+        // Vendor-specific PCI capability that describes a virtio structure
+        PCI_CAP_ID_VENDOR = 0x09,
+
+        VIRTIO_PCI_CAP_COMMON_CFG = 1,
+        VIRTIO_PCI_CAP_NOTIFY_CFG = 2,
+
+        STATUS_ACKNOWLEDGE = 1u << 0,
+        STATUS_DRIVER = 1u << 1,
+        STATUS_DRIVER_OK = 1u << 2,
+        STATUS_FEATURES_OK = 1u << 3,
+
+        // Bit 32 of the feature bits: the device is not a legacy device
+        FEATURE_HI_VERSION_1 = 1u << 0,
+
+        // Queue 0 is the receive queue of port 0, queue 1 its transmit queue.
+        TX_QUEUE_INDEX = 1,
+
+        VIRTQ_USED_F_NO_NOTIFY = 1u << 0,
+
+        MSIX_NO_VECTOR = 0xffff,
+    };
+
+    struct __attribute__((packed)) virtio_pci_cap
+    {
+        uint8_t cap_vndr;
+        uint8_t cap_next;
+        uint8_t cap_len;
+        uint8_t cfg_type;
+        uint8_t bar;
+        uint8_t id;
+        uint8_t padding[2];
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct __attribute__((packed)) virtio_pci_notify_cap
+    {
+        virtio_pci_cap cap;
+        uint32_t notify_off_multiplier;
+    };
+
+    // How long we wait for the device to return a buffer
+    constexpr unsigned RECLAIM_RETRIES{ 10000000 };
+}  // namespace
+
+console_virtio::console_virtio(const pci_device& dev, const cbl::interval& dma_region)
+    : dma_base_(dma_region.a), queue_(*reinterpret_cast<virtq*>(dma_region.a))
+{
+    ASSERT(dma_region.size() >= DMA_PAGES * PAGE_SIZE, "DMA region too small for virtio console");
+    memset(reinterpret_cast<void*>(dma_base_), 0, DMA_PAGES * PAGE_SIZE);
+
+    if (not find_structures(dev)) {
+        return;
+    }
+
+    dev.enable_bus_master();
+
+    // Reset the device and wait until it is done.
+    common_->device_status = 0;
+    while (common_->device_status != 0) {
+        cpu_pause();
+    }
+
+    common_->device_status = STATUS_ACKNOWLEDGE;
+    common_->device_status = STATUS_ACKNOWLEDGE | STATUS_DRIVER;
+
+    // We need none of the console features, only the modern interface.
+    common_->device_feature_select = 1;
+    if (not(common_->device_feature & FEATURE_HI_VERSION_1)) {
+        return;
+    }
+
+    common_->driver_feature_select = 0;
+    common_->driver_feature = 0;
+    common_->driver_feature_select = 1;
+    common_->driver_feature = FEATURE_HI_VERSION_1;
+
+    common_->device_status = STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK;
+    if (not(common_->device_status & STATUS_FEATURES_OK)) {
+        return;
+    }
+
+    if (not setup_tx_queue()) {
+        return;
+    }
+
+    common_->device_status = STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_FEATURES_OK | STATUS_DRIVER_OK;
+    ready_ = true;
+}
+
+bool console_virtio::find_structures(const pci_device& dev)
+{
+    auto bar_address = [&dev](unsigned bar) -> uintptr_t {
+        return bar < PCI_NUM_BARS and dev.bar(bar)->is_mem() ? dev.bar(bar)->address() : 0;
+    };
+
+    uint32_t notify_off_multiplier{ 0 };
+    uintptr_t notify_base{ 0 };
+
+    auto caps{ dev.get_capabilities() };
+    for (auto it{ caps.begin() }; it != caps.end(); ++it) {
+        if ((*it).id != PCI_CAP_ID_VENDOR) {
+            continue;
+        }
+
+        const auto* cap{ reinterpret_cast<const volatile virtio_pci_cap*>(uintptr_t(dev.cfg_base()) + it.offset()) };
+        auto base{ bar_address(cap->bar) };
+        if (base == 0) {
+            continue;
+        }
+
+        switch (cap->cfg_type) {
+            case VIRTIO_PCI_CAP_COMMON_CFG:
+                if (common_ == nullptr) {
+                    common_ = reinterpret_cast<volatile common_cfg*>(base + cap->offset);
+                }
+                break;
+            case VIRTIO_PCI_CAP_NOTIFY_CFG:
+                if (notify_base == 0) {
+                    notify_base = base + cap->offset;
+                    notify_off_multiplier = reinterpret_cast<const volatile virtio_pci_notify_cap*>(cap)->notify_off_multiplier;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (common_ == nullptr or notify_base == 0) {
+        return false;
+    }
+
+    common_->queue_select = TX_QUEUE_INDEX;
+    notify_ = reinterpret_cast<volatile uint16_t*>(notify_base + common_->queue_notify_off * notify_off_multiplier);
+
+    return true;
+}
+
+bool console_virtio::setup_tx_queue()
+{
+    if (common_->num_queues <= TX_QUEUE_INDEX) {
+        return false;
+    }
+
+    common_->queue_select = TX_QUEUE_INDEX;
+
+    // The device tells us the maximum size. We may use a smaller power of two.
+    if (common_->queue_size < TX_QUEUE_SIZE) {
+        return false;
+    }
+    common_->queue_size = TX_QUEUE_SIZE;
+    common_->queue_msix_vector = MSIX_NO_VECTOR;
+
+    auto desc{ ptr_to_num(&queue_.desc) };
+    auto avail{ ptr_to_num(&queue_.avail) };
+    auto used{ ptr_to_num(&queue_.used) };
+
+    common_->queue_desc_lo = static_cast<uint32_t>(desc);
+    common_->queue_desc_hi = static_cast<uint32_t>(desc >> 32);
+    common_->queue_driver_lo = static_cast<uint32_t>(avail);
+    common_->queue_driver_hi = static_cast<uint32_t>(avail >> 32);
+    common_->queue_device_lo = static_cast<uint32_t>(used);
+    common_->queue_device_hi = static_cast<uint32_t>(used >> 32);
+
+    // Every transmit buffer has a fixed descriptor.
+    for (size_t slot{ 0 }; slot < TX_QUEUE_SIZE; slot++) {
+        queue_.desc[slot].addr = ptr_to_num(tx_buffer(slot));
+    }
+
+    common_->queue_enable = 1;
+    return true;
+}
+
+void console_virtio::reclaim_buffers()
+{
+    auto used_idx{ __atomic_load_n(&queue_.used.idx, __ATOMIC_ACQUIRE) };
+
+    while (last_used_idx_ != used_idx) {
+        auto id{ queue_.used.ring[last_used_idx_ % TX_QUEUE_SIZE].id };
+        if (id < TX_QUEUE_SIZE) {
+            in_flight_[id] = false;
+        }
+        last_used_idx_++;
+    }
+}
+
+void console_virtio::flush()
+{
+    if (not ready_ or current_length_ == 0) {
+        return;
+    }
+
+    auto slot{ current_slot_ };
+    queue_.desc[slot].len = static_cast<uint32_t>(current_length_);
+    queue_.desc[slot].flags = 0;
+    in_flight_[slot] = true;
+
+    auto avail_idx{ queue_.avail.idx };
+    queue_.avail.ring[avail_idx % TX_QUEUE_SIZE] = static_cast<uint16_t>(slot);
+    __atomic_store_n(&queue_.avail.idx, static_cast<uint16_t>(avail_idx + 1), __ATOMIC_RELEASE);
+
+    // The notification must not overtake the index update.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (not(__atomic_load_n(&queue_.used.flags, __ATOMIC_ACQUIRE) & VIRTQ_USED_F_NO_NOTIFY)) {
+        *notify_ = TX_QUEUE_INDEX;
+    }
+
+    current_slot_ = (current_slot_ + 1) % TX_QUEUE_SIZE;
+    current_length_ = 0;
+
+    // The next buffer may still be in flight from the last round.
+    for (unsigned retry{ 0 }; in_flight_[current_slot_]; retry++) {
+        reclaim_buffers();
+        if (retry == RECLAIM_RETRIES) {
+            // The device does not process our buffers. Drop further output
+            // instead of hanging.
+            ready_ = false;
+            return;
+        }
+        cpu_pause();
+    }
+}
+
+void console_virtio::putc(char c)
+{
+    if (not ready_) {
+        return;
+    }
+
+    tx_buffer(current_slot_)[current_length_++] = c;
+    if (current_length_ == TX_BUF_SIZE or c == '\n') {
+        flush();
+    }
+}
+
+void console_virtio::write(const char* data, size_t size)
+{
+    bool line_ending{ false };
+
+    while (ready_ and size > 0) {
+        auto chunk{ std::min(size, TX_BUF_SIZE - current_length_) };
+
+        memcpy(tx_buffer(current_slot_) + current_length_, data, chunk);
+        line_ending = line_ending or memchr(data, '\n', chunk) != nullptr;
+        current_length_ += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (current_length_ == TX_BUF_SIZE) {
+            flush();
+        }
+    }
+
+    // Send complete lines right away, like putc() does.
+    if (line_ending) {
+        flush();
+    }
+}
+
+void console_virtio::putchar(unsigned char c)
+{
+    if (active_console) {
+        active_console->putc(c);
+    }
+}
+
+void console_virtio::write_buffer(const char* data, size_t size)
+{
+    if (active_console) {
+        active_console->write(data, size);
+    }
+}
+
+bool console_virtio::is_active()
+{
+    return active_console != nullptr;
+}
+
+void virtio_console_init(console_virtio& cons)
+{
+    active_console = &cons;
+    add_printf_backend(console_virtio::putchar, console_virtio::write_buffer);
+}
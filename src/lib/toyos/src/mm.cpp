@@ -3,11 +3,119 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <toyos/irq_guard.hpp>
+#include <toyos/memory/system_memory.hpp>
 #include <toyos/mm.hpp>
 #include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/cpuid.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/spinlock.hpp>
+
+#include <array>
+#include <cstring>
 
 using x86::cr4;
 
+namespace
+{
+    // Serializes changes of the page tables by map_range().
+    cbl::spinlock mapping_lock;
+
+    constexpr size_t TABLE_ENTRIES{ PAGE_SIZE / sizeof(uint64_t) };
+
+    constexpr math::order_t ORDER_2M{ math::order_max(2_MiB) };
+    constexpr math::order_t ORDER_1G{ math::order_max(1_GiB) };
+
+    // Bits of large page entries that differ from 4K page entries
+    constexpr uint64_t PS_BIT{ math::mask(1, 7) };
+    constexpr uint64_t LARGE_PAT_BIT{ math::mask(1, 12) };
+
+    template<class TABLE>
+    TABLE& table_at(phy_addr_t addr)
+    {
+        return *num_to_ptr<TABLE>(uintptr_t(memory_manager::phy_to_lin(addr)));
+    }
+
+    template<class TABLE>
+    TABLE& alloc_table()
+    {
+        auto page{ alloc_phys(PAGE_BITS) };
+        PANIC_UNLESS(page, "Out of memory for page tables");
+
+        auto* table{ num_to_ptr<void>(uintptr_t(memory_manager::phy_to_lin(*page))) };
+        memset(table, 0, PAGE_SIZE);
+        return *static_cast<TABLE*>(table);
+    }
+
+    bool fits(uintptr_t lin, uintptr_t phys, size_t remaining, math::order_t order, const memory_manager::mapping_attributes& attrs)
+    {
+        return order <= attrs.max_page_order and math::is_aligned(lin, order) and math::is_aligned(phys, order) and remaining >= (size_t(1) << order);
+    }
+
+    PDE::pd_entry_t directory_config(uintptr_t table)
+    {
+        return { .address = table, .present = true, .readwrite = true, .usermode = true };
+    }
+
+    PDE::pd_entry_t large_page_config(uintptr_t phys, const memory_manager::mapping_attributes& attrs)
+    {
+        return { .address = phys,
+                 .present = true,
+                 .readwrite = attrs.writeable,
+                 .usermode = attrs.usermode,
+                 .pwt = attrs.pwt,
+                 .pcd = attrs.pcd,
+                 .global = attrs.global,
+                 .pat = attrs.pat,
+                 .execute = attrs.exec_disable };
+    }
+}  // namespace
+
+/* Collects the linear addresses whose translation changed. Above a threshold, a single
+ * flush of the whole TLB is cheaper than invalidating every page.
+ */
+class memory_manager::tlb_batch
+{
+ public:
+    explicit tlb_batch(bool global)
+        : global_(global) {}
+
+    void add(uintptr_t lin)
+    {
+        if (count < addrs.size()) {
+            addrs[count++] = lin;
+        }
+        else {
+            all = true;
+        }
+    }
+
+    void add_all()
+    {
+        all = true;
+    }
+
+    void flush() const
+    {
+        if (all) {
+            global_ ? invalidate_tlb_all() : invalidate_tlb_non_global();
+            return;
+        }
+
+        for (size_t i{ 0 }; i < count; i++) {
+            invalidate_tlb(lin_addr_t(addrs[i]));
+        }
+    }
+
+ private:
+    static constexpr size_t MAX_INVLPG{ 32 };
+
+    bool global_;
+    bool all{ false };
+
+    std::array<uintptr_t, MAX_INVLPG> addrs{};
+    size_t count{ 0 };
+};
+
 void memory_manager::set_pml4(PML4& pml4)
 {
     uint64_t cr3_val = get_cr3();
@@ -108,6 +216,136 @@ lin_addr_t memory_manager::phy_to_lin(phy_addr_t phy_addr)
     return lin_addr_t(uintptr_t(phy_addr));
 }
 
+void memory_manager::map_range(lin_addr_t lin_addr, phy_addr_t phy_addr, size_t size, const mapping_attributes& attrs)
+{
+    auto lin{ uintptr_t(lin_addr) };
+    auto phys{ uintptr_t(phy_addr) };
+    PANIC_UNLESS(math::is_aligned(lin, PAGE_BITS) and math::is_aligned(phys, PAGE_BITS) and math::is_aligned(size, PAGE_BITS),
+                 "Unaligned mapping of {#x} to {#x} with size {#x}", lin, phys, size);
+
+    static const bool gb_pages{ util::cpuid::has_1gb_pages() };
+
+    cbl::spinlock::guard _{ mapping_lock };
+    tlb_batch batch{ attrs.global };
+
+    for (auto end{ lin + size }; lin < end;) {
+        auto remaining{ end - lin };
+        auto& pdpte{ pdpt_for_mapping(lin_addr_t(lin), batch)[pdpt_offset(lin_addr_t(lin))] };
+
+        if (gb_pages and fits(lin, phys, remaining, ORDER_1G, attrs)) {
+            if (pdpte.is_present()) {
+                pdpte.is_large() ? batch.add(lin) : batch.add_all();
+            }
+            pdpte = PDPTE::pdpte_to_1gb_page(large_page_config(phys, attrs));
+
+            lin += 1_GiB;
+            phys += 1_GiB;
+            continue;
+        }
+
+        auto& pde{ pd_for_mapping(pdpte)[pd_offset(lin_addr_t(lin))] };
+
+        if (fits(lin, phys, remaining, ORDER_2M, attrs)) {
+            if (pde.is_present()) {
+                pde.is_large() ? batch.add(lin) : batch.add_all();
+            }
+            pde = PDE::pde_to_2mb_page(large_page_config(phys, attrs));
+
+            lin += 2_MiB;
+            phys += 2_MiB;
+            continue;
+        }
+
+        auto& pte{ pt_for_mapping(pde)[pt_offset(lin_addr_t(lin))] };
+        if (pte.is_present()) {
+            batch.add(lin);
+        }
+        pte = PTE({ .address = phys,
+                    .present = true,
+                    .readwrite = attrs.writeable,
+                    .usermode = attrs.usermode,
+                    .pwt = attrs.pwt,
+                    .pcd = attrs.pcd,
+                    .pat = attrs.pat,
+                    .global = attrs.global,
+                    .execute = attrs.exec_disable });
+
+        lin += PAGE_SIZE;
+        phys += PAGE_SIZE;
+    }
+
+    batch.flush();
+}
+
+PDPT& memory_manager::pdpt_for_mapping(lin_addr_t lin_addr, tlb_batch& batch)
+{
+    auto& root{ pml4() };
+    auto idx{ pml4_offset(lin_addr) };
+    auto& pml4e{ root[idx] };
+
+    // The boot page tables point all PML4 entries to the same PDPT. Mappings
+    // beyond the first 512 GiB get a PDPT of their own, so they don't change
+    // the first 512 GiB. The aliases are dropped.
+    bool aliased{ idx != 0 and pml4e.is_present() and root[0].is_present()
+                  and uintptr_t(*pml4e.get_pdpt()) == uintptr_t(*root[0].get_pdpt()) };
+
+    if (pml4e.is_present() and not aliased) {
+        return table_at<PDPT>(*pml4e.get_pdpt());
+    }
+
+    if (aliased) {
+        batch.add_all();
+    }
+
+    auto& pdpt{ alloc_table<PDPT>() };
+    pml4e = PML4E({ .address = ptr_to_num(&pdpt), .present = true, .readwrite = true, .usermode = true });
+    return pdpt;
+}
+
+PD& memory_manager::pd_for_mapping(PDPTE& pdpte)
+{
+    if (pdpte.is_present() and not pdpte.is_large()) {
+        return table_at<PD>(*pdpte.get_pdir());
+    }
+
+    auto& pd{ alloc_table<PD>() };
+
+    // A 1 GiB page is split into 2 MiB pages with the same attributes. Both
+    // entries have the same layout, so only the address changes.
+    if (pdpte.is_large()) {
+        auto raw{ uint64_t(pdpte) & ~uintptr_t(*pdpte.get_page()) };
+        for (size_t i{ 0 }; i < TABLE_ENTRIES; i++) {
+            pd[i] = PDE(raw | (uintptr_t(*pdpte.get_page()) + i * 2_MiB));
+        }
+    }
+
+    // The translations stay the same, so the TLB does not need to be flushed.
+    pdpte = PDPTE::pdpte_to_pdir(directory_config(ptr_to_num(&pd)));
+    return pd;
+}
+
+PT& memory_manager::pt_for_mapping(PDE& pde)
+{
+    if (pde.is_present() and not pde.is_large()) {
+        return table_at<PT>(*pde.get_pt());
+    }
+
+    auto& pt{ alloc_table<PT>() };
+
+    // A 2 MiB page is split into 4 KiB pages with the same attributes. The
+    // PAT bit of 4 KiB pages takes the place of the page size bit.
+    if (pde.is_large()) {
+        auto base{ uintptr_t(*pde.get_page()) };
+        auto raw{ (uint64_t(pde) & ~base & ~PS_BIT & ~LARGE_PAT_BIT) | (pde.is_pat() ? PS_BIT : 0) };
+        for (size_t i{ 0 }; i < TABLE_ENTRIES; i++) {
+            pt[i] = PTE(raw | (base + i * PAGE_SIZE));
+        }
+    }
+
+    pde = PDE::pde_to_pt(directory_config(ptr_to_num(&pt)));
+    return pt;
+}
+
 uint64_t memory_manager::pml4_offset(lin_addr_t lin_addr)
 {
     uint64_t addr = uintptr_t(lin_addr);
@@ -0,0 +1,25 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <toyos/console/console_memory.hpp>
+#include <toyos/panic.hpp>
+
+static bool panicking{ false };
+
+void begin_panic_output()
+{
+    // Only the first panic prepares the output, in case preparing it panics.
+    if (__atomic_exchange_n(&panicking, true, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    // Output that was captured in memory would be lost with the trap, and so
+    // would the panic message.
+    memory_console::resume();
+}
+
+bool panic_in_progress()
+{
+    return __atomic_load_n(&panicking, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,41 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <toyos/per_cpu.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+#include <toyos/x86/x86defs.hpp>
+
+static cpu_local_area cpu_local_areas[MAX_CPUS];
+static size_t cpus_online{ 0 };
+
+void init_cpu_local(uint32_t cpu_index)
+{
+    PANIC_UNLESS(cpu_index < MAX_CPUS, "CPU index {} exceeds MAX_CPUS", cpu_index);
+
+    auto& area{ cpu_local_areas[cpu_index] };
+    area.self = &area;
+    area.cpu_index = cpu_index;
+    area.apic_id = cpuid(CPUID_LEAF_FAMILY_FEATURES).ebx >> 24;
+
+    // WRGSBASE depends on CR4.FSGSBASE, the MSR is always available in long mode.
+    wrmsr(x86::GS_BASE, reinterpret_cast<uintptr_t>(&area));
+
+    __atomic_fetch_add(&cpus_online, 1, __ATOMIC_SEQ_CST);
+}
+
+cpu_local_area& cpu_local_area_of(size_t cpu_index)
+{
+    return cpu_local_areas[cpu_index];
+}
+
+size_t online_cpus()
+{
+    return __atomic_load_n(&cpus_online, __ATOMIC_SEQ_CST);
+}
+
+EXTERN_C void init_cpu_local_bsp()
+{
+    init_cpu_local(0);
+}
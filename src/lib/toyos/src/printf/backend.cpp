@@ -2,51 +2,264 @@
 //
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <toyos/irq_guard.hpp>
+#include <toyos/panic.hpp>
+#include <toyos/per_cpu.hpp>
 #include <toyos/printf/backend.hpp>
 #include <toyos/printf/xprintf.h>
+#include <toyos/util/mpsc_ring.hpp>
+#include <toyos/util/spinlock.hpp>
 
 #include <array>
+#include <cstring>
 
-// The library could be used in context where dynamic memory allocation
-// is unsupported, e.g. in early boot stages.
-// Hence, the number of possible backends is fixed.
-static constexpr size_t MAX_BACKENDS{ 3 };
+static printf_backend_list backends;
 
-static std::array<printf_backend_fn, MAX_BACKENDS> backends;
+// Backends drive hardware that must not be accessed by multiple CPUs at once.
+static cbl::spinlock backend_lock;
+
+// How often a panicking CPU tries to get the backend lock before it writes
+// without it.
+static constexpr uint64_t PANIC_LOCK_ATTEMPTS{ 1'000'000 };
+
+/**
+ * Grants exclusive access to the backends.
+ *
+ * Interrupts are disabled while the backends are in use, so an interrupt
+ * handler that prints cannot run into the lock that the interrupted code
+ * holds. With a single CPU online, this is all that is needed and the lock
+ * is not touched.
+ */
+class backend_guard
+{
+ public:
+    backend_guard()
+    {
+        if (panic_in_progress()) {
+            // The lock may be held by the panicking CPU itself.
+            locked_ = backend_lock.try_lock_bounded(PANIC_LOCK_ATTEMPTS);
+        }
+        else if (online_cpus() > 1) {
+            backend_lock.lock();
+            locked_ = true;
+        }
+    }
+
+    ~backend_guard()
+    {
+        if (locked_) {
+            backend_lock.unlock();
+        }
+    }
+
+ private:
+    irq_guard irqs_;
+    bool locked_{ false };
+};
+
+static per_cpu<std::string*> capture_buffer{ nullptr };
+
+// Output is collected per CPU and handed to the backends in chunks: at the
+// end of every printf call, when a line is complete or when the buffer is
+// full.
+//
+// With more than one CPU online, only complete lines are handed out and they
+// are queued in a lock-free ring first. Whichever CPU gets hold of the
+// backends writes the queued lines, so lines of different CPUs never
+// interleave and a CPU does not wait for the console while another one is
+// printing.
+static constexpr size_t LOG_RECORD_SIZE{ 128 };
+static constexpr size_t LOG_RING_RECORDS{ 256 };
+
+struct log_record
+{
+    uint16_t length;
+    std::array<char, LOG_RECORD_SIZE - sizeof(uint16_t)> text;
+};
+
+static cbl::mpsc_ring<log_record, LOG_RING_RECORDS> log_ring;
+static per_cpu<log_record> pending_line;
+
+static void write_to_all_backends_locked(const char* data, size_t size)
+{
+    for (const auto& b : backends) {
+        if (b.write != nullptr) {
+            b.write(data, size);
+        }
+        else if (b.putc != nullptr) {
+            for (size_t i{ 0 }; i < size; i++) {
+                b.putc(static_cast<unsigned char>(data[i]));
+            }
+        }
+    }
+}
+
+static void drain_log_ring_locked()
+{
+    auto write_record = [](const log_record& record) { write_to_all_backends_locked(record.text.data(), record.length); };
+
+    while (log_ring.consume(write_record)) {
+    }
+}
+
+static void try_drain_log_ring()
+{
+    // A line may be queued right after the current drainer found the ring
+    // empty, so check again after the lock was released.
+    while (not log_ring.empty()) {
+        irq_guard _;
+        if (not backend_lock.try_lock()) {
+            return;
+        }
+        drain_log_ring_locked();
+        backend_lock.unlock();
+    }
+}
+
+static void submit_line(log_record& line)
+{
+    while (not log_ring.push(line)) {
+        // The ring is full, so somebody has to make room.
+        backend_guard _;
+        drain_log_ring_locked();
+    }
+
+    line.length = 0;
+    try_drain_log_ring();
+}
+
+/// Hands the buffered output of the calling CPU to the backends.
+static void write_pending(log_record& line)
+{
+    // A panic message goes out directly, because nobody may drain the ring
+    // afterwards.
+    if (online_cpus() > 1 and not panic_in_progress()) {
+        submit_line(line);
+        return;
+    }
+
+    backend_guard _;
+    drain_log_ring_locked();
+    write_to_all_backends_locked(line.text.data(), line.length);
+    line.length = 0;
+}
 
 void print_to_all_backends(unsigned char c)
 {
-    for (const auto& print_fn : backends) {
-        if (print_fn != nullptr) {
-            print_fn(c);
+    if (auto* buffer{ capture_buffer.local() }; buffer != nullptr and not panic_in_progress()) {
+        buffer->push_back(static_cast<char>(c));
+        return;
+    }
+
+    auto& line{ pending_line.local() };
+    line.text[line.length++] = static_cast<char>(c);
+
+    if (c == '\n' or line.length == line.text.size()) {
+        write_pending(line);
+    }
+}
+
+/// Called at the end of every printf call.
+static void end_of_printf_call()
+{
+    auto& line{ pending_line.local() };
+
+    // With other CPUs online, we wait for the line to be completed.
+    if ((online_cpus() == 1 or panic_in_progress()) and line.length != 0) {
+        write_pending(line);
+    }
+}
+
+void write_printf_output(const char* data, size_t size)
+{
+    if (auto* buffer{ capture_buffer.local() }; buffer != nullptr and not panic_in_progress()) {
+        buffer->append(data, size);
+        return;
+    }
+
+    auto& line{ pending_line.local() };
+    while (size > 0) {
+        auto chunk{ std::min(size, line.text.size() - line.length) };
+        auto* newline{ static_cast<const char*>(memchr(data, '\n', chunk)) };
+        if (newline != nullptr) {
+            chunk = static_cast<size_t>(newline - data) + 1;
+        }
+
+        memcpy(line.text.data() + line.length, data, chunk);
+        line.length += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (newline != nullptr or line.length == line.text.size()) {
+            write_pending(line);
         }
     }
+
+    end_of_printf_call();
+}
+
+void flush_printf_output()
+{
+    auto& line{ pending_line.local() };
+    if (line.length != 0) {
+        write_pending(line);
+    }
+
+    backend_guard _;
+    drain_log_ring_locked();
 }
 
-void add_printf_backend(printf_backend_fn backend)
+void capture_printf_output(std::string* buffer)
 {
-    auto free_slot{ std::find(backends.begin(), backends.end(), nullptr) };
+    capture_buffer.local() = buffer;
+}
+
+void print_to_backends(const std::string& output)
+{
+    backend_guard _;
+    drain_log_ring_locked();
+    write_to_all_backends_locked(output.data(), output.size());
+}
+
+void add_printf_backend(printf_backend_fn backend, printf_write_fn write)
+{
+    auto free_slot{ std::find_if(backends.begin(), backends.end(), [](const auto& b) { return b.putc == nullptr; }) };
     if (free_slot == backends.end()) {
         // no more space - alert on already registered backends
         puts("maximum number of printf backends already registered");
         __builtin_trap();
     }
-    *free_slot = backend;
+    *free_slot = { backend, write };
 
     // backends are expected to be seldom added/removed, so re-registering
     // on every call ain't harmful
     xdev_out(print_to_all_backends);
+    xdev_flush(end_of_printf_call);
 }
 
 void remove_printf_backend(printf_backend_fn backend)
 {
-    auto existing = std::find(backends.begin(), backends.end(), backend);
+    auto existing = std::find_if(backends.begin(), backends.end(), [backend](const auto& b) { return b.putc == backend; });
     if (existing != backends.end()) {
-        *existing = nullptr;
+        *existing = {};
     }
 }
 
 void remove_all_printf_backends()
 {
-    backends.fill(nullptr);
+    backends.fill({});
+}
+
+printf_backend_list exchange_printf_backends(const printf_backend_list& replacement)
+{
+    backend_guard _;
+    drain_log_ring_locked();
+
+    auto previous{ backends };
+    backends = replacement;
+
+    xdev_out(print_to_all_backends);
+    xdev_flush(end_of_printf_call);
+
+    return previous;
 }
@@ -20,6 +20,7 @@ static char* const max_ptr = (char*)-1;
 
 #if _USE_XFUNC_OUT
 void (*xfunc_out)(unsigned char); /* Pointer to the output stream */
+void (*xfunc_flush)(void);        /* Pointer to the flush function of the output stream */
 
 #ifndef LIB_TYPE_HOSTED
 /*----------------------------------------------*/
@@ -52,9 +53,17 @@ putc_internal(char c, char** outptr, char* outptr_limit)
     return 0;
 }
 
+static void flush_output(void)
+{
+    if (xfunc_flush)
+        xfunc_flush();
+}
+
 int putc(char c)
 {
-    return putc_internal(c, 0, max_ptr);
+    putc_internal(c, 0, max_ptr);
+    flush_output();
+    return 0;
 }
 
 int putchar(int c)
@@ -82,6 +91,7 @@ int puts(const char* str)
 {
     int ret = puts_internal(str, 0, max_ptr);
     putc_internal('\n', 0, max_ptr);
+    flush_output();
     return ret;
 }
 
@@ -263,6 +273,7 @@ static void xvprintf_internal(const char* fmt, va_list arp, char** outptr, char*
 int vprintf(const char* fmt, va_list arp)
 {
     xvprintf_internal(fmt, arp, 0, max_ptr);
+    flush_output();
     return 0;
 }
 
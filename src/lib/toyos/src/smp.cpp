@@ -0,0 +1,225 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <toyos/binary_trace.hpp>
+#include <toyos/printf/backend.hpp>
+#include <toyos/smp.hpp>
+#include <toyos/testhelper/irq_handler.hpp>
+#include <toyos/testhelper/lapic_enabler.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/math.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+#include <toyos/x86/x86defs.hpp>
+
+extern char ap_trampoline_start[];
+extern char ap_trampoline_end[];
+extern uint32_t ap_trampoline_cr0;
+extern uint32_t ap_trampoline_cr3;
+extern uint32_t ap_trampoline_cr4;
+extern uint32_t ap_trampoline_efer;
+extern uint32_t ap_trampoline_next_cpu;
+
+namespace
+{
+
+    struct mailbox
+    {
+        smp::job_fn job;
+        bool busy{ false };
+    };
+
+    per_cpu<mailbox> mailboxes;
+
+    bool aps_started{ false };
+    uint64_t bsp_xcr0{ 0 };
+
+    // We have no calibrated time source this early. Overestimating the TSC
+    // frequency only makes the startup delays longer than necessary.
+    constexpr uint64_t TSC_TICKS_PER_US_UPPER_BOUND{ 5000 };
+
+    constexpr uint64_t INIT_DELAY_US{ 10000 };
+    constexpr uint64_t SIPI_DELAY_US{ 200 };
+
+    // Give up waiting for more APs if none arrived for this long.
+    constexpr uint64_t AP_ARRIVAL_TIMEOUT_US{ 100000 };
+
+    void spin_us(uint64_t us)
+    {
+        auto target{ rdtsc() + us * TSC_TICKS_PER_US_UPPER_BOUND };
+        while (rdtsc() < target) {
+            cpu_pause();
+        }
+    }
+
+    /// Returns the location of a trampoline variable in the copy in low memory.
+    uint32_t& trampoline_field(uint32_t& field)
+    {
+        auto offset{ ptr_to_num(&field) - ptr_to_num(ap_trampoline_start) };
+        return *num_to_ptr<uint32_t>(AP_TRAMPOLINE_ADDR + offset);
+    }
+
+    void prepare_trampoline()
+    {
+        using x86::cr4;
+
+        // These bits can't be set outside of long mode or would need more
+        // setup than the trampoline does.
+        static constexpr uint64_t CR4_UNSUPPORTED{ math::mask_from(cr4::PCIDE, cr4::VMXE, cr4::SMXE) };
+
+        ap_trampoline_cr0 = static_cast<uint32_t>(get_cr0());
+        ap_trampoline_cr3 = static_cast<uint32_t>(get_cr3());
+        ap_trampoline_cr4 = static_cast<uint32_t>(get_cr4() & ~CR4_UNSUPPORTED);
+        ap_trampoline_efer = static_cast<uint32_t>(rdmsr(x86::EFER) & ~x86::EFER_LMA);
+
+        PANIC_UNLESS(ap_trampoline_cr3 == get_cr3(), "AP startup needs page tables below 4 GiB");
+
+        if (get_cr4() & math::mask_from(cr4::OSXSAVE)) {
+            bsp_xcr0 = get_xcr();
+        }
+    }
+
+    void send_init_sipi_sipi()
+    {
+        using namespace lapic_test_tools;
+
+        lapic_enabler _;
+
+        send_self_ipi(0, dest_sh::ALL_EXC_SELF, dest_mode::PHYSICAL, lvt_dlv_mode::INIT);
+        spin_us(INIT_DELAY_US);
+
+        for (unsigned i{ 0 }; i < 2; i++) {
+            send_self_ipi(AP_TRAMPOLINE_ADDR >> PAGE_BITS, dest_sh::ALL_EXC_SELF, dest_mode::PHYSICAL, lvt_dlv_mode::START_UP);
+            spin_us(SIPI_DELAY_US);
+        }
+    }
+
+    /// Waits until all APs that received a CPU index have initialized their per-CPU area.
+    void wait_for_ap_arrival()
+    {
+        auto& next_cpu{ trampoline_field(ap_trampoline_next_cpu) };
+
+        size_t last_seen{ 0 };
+        auto deadline{ rdtsc() + AP_ARRIVAL_TIMEOUT_US * TSC_TICKS_PER_US_UPPER_BOUND };
+
+        while (rdtsc() < deadline or online_cpus() != std::min<size_t>(__atomic_load_n(&next_cpu, __ATOMIC_SEQ_CST), MAX_CPUS)) {
+            auto arrived{ __atomic_load_n(&next_cpu, __ATOMIC_SEQ_CST) };
+            if (arrived != last_seen) {
+                last_seen = arrived;
+                deadline = rdtsc() + AP_ARRIVAL_TIMEOUT_US * TSC_TICKS_PER_US_UPPER_BOUND;
+            }
+            cpu_pause();
+        }
+    }
+
+}  // namespace
+
+/// High-level entry point of every AP. Called from ap_boot.S.
+EXTERN_C [[noreturn]] void ap_entry(uint32_t cpu_index)
+{
+    init_cpu_local(cpu_index);
+    global_idt.load();
+
+    if (get_cr4() & math::mask_from(x86::cr4::OSXSAVE)) {
+        set_xcr(bsp_xcr0);
+    }
+
+    auto& mb{ mailboxes.local() };
+    while (true) {
+        while (not __atomic_load_n(&mb.busy, __ATOMIC_ACQUIRE)) {
+            cpu_pause();
+        }
+
+        mb.job();
+        mb.job = nullptr;
+        flush_printf_output();
+
+        __atomic_store_n(&mb.busy, false, __ATOMIC_RELEASE);
+    }
+}
+
+size_t smp::start_aps()
+{
+    if (aps_started) {
+        return online_cpus();
+    }
+    aps_started = true;
+
+    auto* target{ num_to_ptr<char>(AP_TRAMPOLINE_ADDR) };
+    size_t size{ static_cast<size_t>(ap_trampoline_end - ap_trampoline_start) };
+
+    // The trampoline page may still hold data from the firmware or boot loader.
+    std::vector<char> saved(target, target + size);
+
+    prepare_trampoline();
+    memcpy(target, ap_trampoline_start, size);
+
+    send_init_sipi_sipi();
+    wait_for_ap_arrival();
+
+    memcpy(target, saved.data(), size);
+
+    // The APs may trace, and trace points must not allocate.
+    binary_trace::prepare();
+
+    info("{} CPUs online", online_cpus());
+    return online_cpus();
+}
+
+bool smp::cpu_idle(size_t cpu)
+{
+    return cpu < online_cpus() and not __atomic_load_n(&mailboxes[cpu].busy, __ATOMIC_ACQUIRE);
+}
+
+void smp::run_on_cpu_async(size_t cpu, const job_fn& fn)
+{
+    PANIC_UNLESS(cpu != 0 and cpu < online_cpus(), "CPU {} is not an online AP", cpu);
+
+    auto& mb{ mailboxes[cpu] };
+    PANIC_ON(__atomic_load_n(&mb.busy, __ATOMIC_ACQUIRE), "CPU {} is busy", cpu);
+
+    mb.job = fn;
+    __atomic_store_n(&mb.busy, true, __ATOMIC_RELEASE);
+}
+
+void smp::wait_for_cpu(size_t cpu)
+{
+    while (__atomic_load_n(&mailboxes[cpu].busy, __ATOMIC_ACQUIRE)) {
+        cpu_pause();
+    }
+}
+
+void smp::run_on_cpu(size_t cpu, const job_fn& fn)
+{
+    if (cpu == current_cpu()) {
+        fn();
+        return;
+    }
+
+    run_on_cpu_async(cpu, fn);
+    wait_for_cpu(cpu);
+}
+
+void smp::run_on_all_cpus(const std::function<void(size_t)>& fn)
+{
+    auto self{ current_cpu() };
+
+    for (size_t cpu{ 0 }; cpu < online_cpus(); cpu++) {
+        if (cpu != self) {
+            run_on_cpu_async(cpu, [cpu, &fn] { fn(cpu); });
+        }
+    }
+
+    fn(self);
+
+    for (size_t cpu{ 0 }; cpu < online_cpus(); cpu++) {
+        if (cpu != self) {
+            wait_for_cpu(cpu);
+        }
+    }
+}
@@ -2,24 +2,29 @@
 //
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <toyos/panic.hpp>
+#include <toyos/per_cpu.hpp>
 #include <toyos/testhelper/idt.hpp>
 #include <toyos/testhelper/irq_handler.hpp>
 #include <toyos/x86/x86asm.hpp>
 
+// The IDT is shared by all CPUs, but each CPU dispatches to its own handler.
 idt global_idt;
-static irq_handler_t irq_handler_fn = nullptr;
+static per_cpu<irq_handler_t> irq_handler_fn;
 
 void irq_handler::set(const irq_handler_t& new_handler)
 {
-    irq_handler_fn = new_handler;
+    irq_handler_fn.local() = new_handler;
 }
 
 void irq_entry(intr_regs* regs)
 {
-    if (irq_handler_fn) {
-        irq_handler_fn(regs);
+    auto& handler{ irq_handler_fn.local() };
+    if (handler) {
+        handler(regs);
     }
     else {
+        begin_panic_output();
         info("NO INTERRUPT HANDLER DEFINED");
         info("{s}: vector {#x} error code {#x} ip {#x}, ", __func__, regs->vector, regs->error_code, regs->rip);
         disable_interrupts_and_halt();
@@ -28,10 +33,10 @@ void irq_entry(intr_regs* regs)
 
 irq_handler::guard::guard(const irq_handler_t& new_handler)
 {
-    old_handler = irq_handler_fn;
-    irq_handler_fn = new_handler;
+    old_handler = irq_handler_fn.local();
+    irq_handler_fn.local() = new_handler;
 }
 irq_handler::guard::~guard()
 {
-    irq_handler_fn = old_handler;
+    irq_handler_fn.local() = old_handler;
 }
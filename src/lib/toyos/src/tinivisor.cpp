@@ -236,7 +236,10 @@ void tinivisor::clone_segments()
     vmcs.write(encoding::HOST_SEL_FS, fs.selector);
     vmcs.write(encoding::HOST_BASE_FS, fs.base);
     vmcs.write(encoding::HOST_SEL_GS, gs.selector);
-    vmcs.write(encoding::HOST_BASE_GS, gs.base);
+    // The GS base is not taken from the descriptor but from IA32_GS_BASE,
+    // which holds the per-CPU area pointer.
+    vmcs.write(encoding::GUEST_BASE_GS, rdmsr(x86::GS_BASE));
+    vmcs.write(encoding::HOST_BASE_GS, rdmsr(x86::GS_BASE));
     vmcs.write(encoding::HOST_SEL_TR, tr.selector);
     vmcs.write(encoding::HOST_BASE_TR, tr.base);
     vmcs.write(encoding::HOST_BASE_GDTR, gdtr.base);
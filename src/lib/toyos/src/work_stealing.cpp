@@ -0,0 +1,135 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+
+#include <toyos/baretest/config.hpp>
+#include <toyos/per_cpu.hpp>
+#include <toyos/smp.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/util/work_stealing_deque.hpp>
+#include <toyos/util/xorshift.hpp>
+#include <toyos/work_stealing.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+namespace
+{
+
+    using task_deque = cbl::work_stealing_deque<uint32_t, smp::MAX_TASKS_PER_CPU>;
+
+    per_cpu<task_deque> deques;
+
+    /// Number of tasks that are not finished yet.
+    size_t remaining_tasks{ 0 };
+
+    smp::cpu_task_stats work(size_t cpu, size_t cpus, const smp::task_fn& fn)
+    {
+        smp::cpu_task_stats stats;
+        cbl::xorshift rng{ rdtsc() + cpu };
+        auto& own{ deques[cpu] };
+
+        while (__atomic_load_n(&remaining_tasks, __ATOMIC_ACQUIRE) != 0) {
+            auto task{ own.pop() };
+
+            if (not task and cpus > 1) {
+                // Pick a random victim other than ourselves.
+                auto victim{ (cpu + 1 + rng.next() % (cpus - 1)) % cpus };
+                task = deques[victim].steal();
+
+                if (not task) {
+                    stats.failed_steals++;
+                    cpu_pause();
+                    continue;
+                }
+                stats.stolen++;
+            }
+
+            if (not task) {
+                continue;
+            }
+
+            auto start{ rdtsc() };
+            fn(*task);
+            stats.busy_cycles += rdtsc() - start;
+            stats.executed++;
+
+            __atomic_fetch_sub(&remaining_tasks, 1, __ATOMIC_RELEASE);
+        }
+
+        return stats;
+    }
+
+}  // namespace
+
+uint64_t smp::task_run_stats::steals() const
+{
+    uint64_t sum{ 0 };
+    for (const auto& c : cpus) {
+        sum += c.stolen;
+    }
+    return sum;
+}
+
+uint64_t smp::task_run_stats::failed_steals() const
+{
+    uint64_t sum{ 0 };
+    for (const auto& c : cpus) {
+        sum += c.failed_steals;
+    }
+    return sum;
+}
+
+uint64_t smp::task_run_stats::imbalance_percent() const
+{
+    uint64_t sum{ 0 };
+    uint64_t max{ 0 };
+    for (const auto& c : cpus) {
+        sum += c.busy_cycles;
+        max = std::max(max, c.busy_cycles);
+    }
+
+    if (sum == 0) {
+        return 0;
+    }
+
+    // (max / avg - 1) * 100 without losing precision in integer arithmetic
+    return (max * cpus.size() * 100) / sum - 100;
+}
+
+void smp::task_run_stats::report(const std::string& prefix) const
+{
+    baretest::benchmark((prefix + "_steals").c_str(), static_cast<long>(steals()), "tasks");
+    baretest::benchmark((prefix + "_failed_steals").c_str(), static_cast<long>(failed_steals()), "attempts");
+    baretest::benchmark((prefix + "_imbalance").c_str(), static_cast<long>(imbalance_percent()), "%");
+    baretest::benchmark((prefix + "_total").c_str(), static_cast<long>(total_cycles), "cycles");
+}
+
+smp::task_run_stats smp::run_tasks(size_t task_count, const task_fn& fn)
+{
+    size_t cpus{ start_aps() };
+    PANIC_ON(current_cpu() != 0, "Tasks can only be scheduled from the BSP");
+    PANIC_ON(task_count > cpus * MAX_TASKS_PER_CPU, "Too many tasks: {}", task_count);
+
+    // Nobody else touches the deques yet, so we may push on behalf of their owners.
+    for (size_t cpu{ 0 }; cpu < cpus; cpu++) {
+        auto first{ task_count * cpu / cpus };
+        auto last{ task_count * (cpu + 1) / cpus };
+
+        // Push in reverse, so the owner pops its block in ascending order.
+        for (auto task{ last }; task > first; task--) {
+            PANIC_UNLESS(deques[cpu].push(static_cast<uint32_t>(task - 1)), "Task deque overflow");
+        }
+    }
+
+    __atomic_store_n(&remaining_tasks, task_count, __ATOMIC_RELEASE);
+
+    task_run_stats stats;
+    stats.cpus.resize(cpus);
+
+    auto start{ rdtsc() };
+    run_on_all_cpus([&](size_t cpu) { stats.cpus[cpu] = work(cpu, cpus, fn); });
+    stats.total_cycles = rdtsc() - start;
+
+    return stats;
+}
@@ -5,6 +5,8 @@
 #include <toyos/printf/backend.hpp>
 #include <toyos/xhci/console.hpp>
 
+#include <algorithm>
+
 static console* active_console;
 
 void xhci_console_base::puts(const std::string& str)
@@ -20,6 +22,16 @@ void xhci_console_base::putc(char c)
     }
 }
 
+void xhci_console_base::write(const char* data, size_t size)
+{
+    dbc_dev_.write(data, size);
+
+    // Send complete lines right away, like putc() does.
+    if (std::any_of(data, data + size, is_line_ending)) {
+        dbc_dev_.flush();
+    }
+}
+
 void xhci_console_base::putchar(unsigned char c)
 {
     if (active_console) {
@@ -27,8 +39,20 @@ void xhci_console_base::putchar(unsigned char c)
     }
 }
 
+void xhci_console_base::write_buffer(const char* data, size_t size)
+{
+    if (active_console) {
+        active_console->write(data, size);
+    }
+}
+
+bool xhci_console_base::is_active()
+{
+    return active_console != nullptr;
+}
+
 void xhci_console_init(xhci_console_base& cons)
 {
     active_console = &cons;
-    add_printf_backend(xhci_console_base::putchar);
+    add_printf_backend(xhci_console_base::putchar, xhci_console_base::write_buffer);
 }
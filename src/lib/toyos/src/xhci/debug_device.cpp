@@ -72,6 +72,7 @@ void xhci_debug_device::setup_info_context()
 void xhci_debug_device::setup_endpoint_contexts()
 {
     out_ring_.initialize();
+    outstanding_transfers_ = 0;
 
     out_ep_ctx_ = dbc_endpoint_context{};
 
@@ -139,6 +140,7 @@ bool xhci_debug_device::handle_events(bool reinit)
                 }
                 else {
                     out_ring_.update_dequeue_ptr(trb.buffer);
+                    out_transfer_completed();
                 }
                 break;
             default:
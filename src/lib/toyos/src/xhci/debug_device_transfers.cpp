@@ -3,36 +3,54 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include "assert.h"
+#include "string.h"
 
 #include <toyos/xhci/debug_device.hpp>
 
 void xhci_debug_device::write_byte(unsigned char c)
 {
-    assert(output_buffer_.length() < OUT_BUF_SIZE);
+    assert(staging_length_ < OUT_BUF_SIZE);
 
-    output_buffer_ += c;
-    if (output_buffer_.length() == OUT_BUF_SIZE) {
+    staging_slot(staging_slot_)[staging_length_++] = static_cast<char>(c);
+    if (staging_length_ == OUT_BUF_SIZE) {
         flush();
     }
 }
 
-void xhci_debug_device::write_line(const std::string& str)
+void xhci_debug_device::write(const char* data, size_t size)
 {
-    flush();
+    while (size > 0) {
+        auto chunk{ std::min(size, OUT_BUF_SIZE - staging_length_) };
 
-    static constexpr size_t CHUNK_SIZE{ std::min(OUT_BUF_SIZE, TRANSFER_MAX) };
+        memcpy(staging_slot(staging_slot_) + staging_length_, data, chunk);
+        staging_length_ += chunk;
+        data += chunk;
+        size -= chunk;
 
-    for (size_t chunk{ 0 }; chunk < (str.length() / CHUNK_SIZE) + 1; chunk++) {
-        auto substring = str.substr(chunk * CHUNK_SIZE, CHUNK_SIZE);
-        queue_write_transfer(substring);
+        if (staging_length_ == OUT_BUF_SIZE) {
+            flush();
+        }
     }
 }
 
+void xhci_debug_device::write_line(const std::string& str)
+{
+    flush();
+    write(str.data(), str.length());
+    flush();
+}
+
 void xhci_debug_device::flush()
 {
-    if (output_buffer_.length() > 0) {
-        queue_write_transfer(output_buffer_);
-        output_buffer_ = "";
+    if (staging_length_ > 0) {
+        // A dropped transfer leaves its slot to the next one. Advancing
+        // anyway could reuse the slot of a stalled transfer.
+        if (queue_write_transfer(staging_slot_, staging_length_)) {
+            // Transfers complete in order, so by the time we come around to
+            // this slot again, the controller is done with it.
+            staging_slot_ = (staging_slot_ + 1) % OUT_STAGING_SLOTS;
+        }
+        staging_length_ = 0;
     }
 }
 
@@ -41,33 +59,67 @@ void xhci_debug_device::update_event_ring_dequeue_ptr()
     dbc_cap_->event_ring_dequeue_ptr = event_ring_buffer_.dma_address(event_ring_.get_dequeue_ptr());
 }
 
-void xhci_debug_device::queue_write_transfer(const std::string& str)
+void xhci_debug_device::out_transfer_completed()
+{
+    outstanding_transfers_ -= outstanding_transfers_ > 0;
+    output_stalled_ = false;
+
+    // The controller copes with single transfers, so let it have more.
+    if (max_outstanding_ < pipeline_limit_ and ++serialized_completions_ >= PIPELINE_PROBE_TRANSFERS) {
+        max_outstanding_ = pipeline_limit_;
+    }
+}
+
+bool xhci_debug_device::queue_write_transfer(size_t slot, size_t length)
 {
     auto _{ init_mtx_->guard() };
 
-    // Apparently, the debug device can't handle multiple outstanding requests.
-    // Until we find out why this happens or how to improve it, we
-    // block until the current request is done.
-    while (not out_ring_.empty()) {
+    // Keep up to max_outstanding_ transfers in flight. Completions are
+    // tracked via transfer events in handle_events().
+    auto pipeline_stall_limit{ DELAY_PIPELINE_STALL / DELAY_RELAX };
+    auto output_stall_limit{ DELAY_OUTPUT_STALL / DELAY_RELAX };
+    for (size_t waited{ 0 }; outstanding_transfers_ >= max_outstanding_ or out_ring_.full(); waited++) {
+        auto outstanding_before{ outstanding_transfers_ };
+
         // Help with the event loop to minimize latency
         if (not handle_events()) {
             // Drop request if connection was lost
-            return;
+            return false;
+        }
+
+        if (outstanding_transfers_ != outstanding_before) {
+            waited = 0;
+            continue;
         }
+
+        if (waited >= static_cast<size_t>(pipeline_stall_limit) and max_outstanding_ > 1) {
+            // Some controllers hang with multiple outstanding requests. We
+            // can't print from here, because we are the console.
+            pipeline_limit_ = 1;
+            max_outstanding_ = 1;
+        }
+
+        if (output_stalled_ or waited >= static_cast<size_t>(output_stall_limit)) {
+            // Nobody reads the output. Drop it instead of hanging until the
+            // debug host reads again.
+            output_stalled_ = true;
+            return false;
+        }
+
         dbc_cap_->ring_doorbell_out();
         adapter_.delay(DELAY_RELAX);
     }
 
     auto& trb = out_ring_.enqueue();
     trb.type(trb_normal::TYPE);
-    auto index = out_ring_.index(ptr_to_num(&trb));
 
-    trb.buffer = out_data_buffer_.dma_addr + index * OUT_BUF_SIZE;
-    trb.length(str.length());
-    str.copy(static_cast<char*>(out_data_buffer_.lin_addr) + index * OUT_BUF_SIZE, str.length());
+    trb.buffer = out_data_buffer_.dma_addr + slot * OUT_BUF_SIZE;
+    trb.length(length);
     trb.set_ioc();
     trb.set_isp();
     trb.commit();
+    outstanding_transfers_++;
 
     dbc_cap_->ring_doorbell_out();
+    return true;
 }
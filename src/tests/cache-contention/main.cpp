@@ -0,0 +1,269 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/per_cpu.hpp>
+#include <toyos/smp.hpp>
+#include <toyos/util/in_place_atomic.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Measures how long it takes to move a cache line between two vCPUs. The
+// latency matrix over all vCPU pairs shows whether vCPUs that are meant to be
+// SMT siblings or on the same NUMA node really share a core or a socket.
+
+static constexpr uint64_t ROUND_TRIPS{ 10000 };
+static constexpr uint64_t INCREMENTS{ 100000 };
+
+enum class transfer_op
+{
+    INC,
+    CAS,
+    XCHG,
+};
+
+struct alignas(CPU_CACHE_LINE_SIZE) shared_line
+{
+    uint64_t value;
+};
+
+static shared_line ping_pong_line;
+
+static bool multiple_cpus()
+{
+    return online_cpus() > 1;
+}
+
+void prologue()
+{
+    smp::start_aps();
+}
+
+/**
+ * Runs side(0) on cpu_a and side(1) on cpu_b at the same time.
+ *
+ * \return The TSC ticks side 0 needed.
+ */
+template<typename FN>
+static uint64_t run_pair(size_t cpu_a, size_t cpu_b, FN side)
+{
+    uint32_t ready{ 0 };
+    uint64_t cycles{ 0 };
+
+    auto body = [&](uint64_t s) {
+        // Start both sides at the same time.
+        __atomic_add_fetch(&ready, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&ready, __ATOMIC_ACQUIRE) != 2) {
+            cpu_pause();
+        }
+
+        auto start{ rdtsc() };
+        side(s);
+        if (s == 0) {
+            cycles = rdtsc() - start;
+        }
+    };
+
+    const std::array<size_t, 2> cpus{ cpu_a, cpu_b };
+    auto self{ current_cpu() };
+
+    for (uint64_t s{ 0 }; s < cpus.size(); s++) {
+        if (cpus[s] != self) {
+            smp::run_on_cpu_async(cpus[s], [&body, s] { body(s); });
+        }
+    }
+
+    for (uint64_t s{ 0 }; s < cpus.size(); s++) {
+        if (cpus[s] == self) {
+            body(s);
+        }
+    }
+
+    for (auto cpu : cpus) {
+        if (cpu != self) {
+            smp::wait_for_cpu(cpu);
+        }
+    }
+
+    return cycles;
+}
+
+/**
+ * Plays one side of a ping-pong on the shared line.
+ *
+ * The counter is advanced alternately by both sides, so every step moves the
+ * line to the other CPU. Spinning is done without PAUSE, because it would
+ * dominate the measured latency.
+ */
+static void ping_pong(transfer_op op, uint64_t side)
+{
+    cbl::in_place_atomic<uint64_t> line{ ping_pong_line.value };
+
+    for (uint64_t round{ 0 }; round < ROUND_TRIPS; round++) {
+        uint64_t turn{ 2 * round + side };
+
+        switch (op) {
+            case transfer_op::INC:
+                while (line.load(std::memory_order_acquire) != turn) {
+                }
+                line.fetch_add(1);
+                break;
+            case transfer_op::CAS:
+                while (not line.compare_exchange_strong(turn, turn + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                }
+                break;
+            case transfer_op::XCHG:
+                while (line.load(std::memory_order_acquire) != turn) {
+                }
+                line.exchange(turn + 1);
+                break;
+        }
+    }
+}
+
+/// Returns the average one-way cache line transfer latency between two CPUs in TSC ticks.
+static uint64_t transfer_latency(transfer_op op, size_t cpu_a, size_t cpu_b)
+{
+    ping_pong_line.value = 0;
+
+    auto cycles{ run_pair(cpu_a, cpu_b, [op](uint64_t side) { ping_pong(op, side); }) };
+
+    // Every round trip consists of two transfers.
+    return cycles / (2 * ROUND_TRIPS);
+}
+
+static void latency_matrix(transfer_op op, const char* name)
+{
+    auto cpus{ online_cpus() };
+    std::vector<uint64_t> latencies;
+
+    printf("%s latency matrix (cycles, one-way):\n", name);
+    printf("      ");
+    for (size_t col{ 0 }; col < cpus; col++) {
+        printf("%6lu", col);
+    }
+    printf("\n");
+
+    for (size_t row{ 0 }; row < cpus; row++) {
+        printf("%4lu: ", row);
+        for (size_t col{ 0 }; col < cpus; col++) {
+            if (row == col) {
+                printf("%6s", "-");
+                continue;
+            }
+
+            auto latency{ transfer_latency(op, row, col) };
+            latencies.push_back(latency);
+            printf("%6lu", latency);
+        }
+        printf("\n");
+    }
+
+    auto [min, max] = std::minmax_element(latencies.begin(), latencies.end());
+
+    BENCHMARK_RESULT((std::string(name) + "_transfer_min").c_str(), *min, "cycles");
+    BENCHMARK_RESULT((std::string(name) + "_transfer_max").c_str(), *max, "cycles");
+}
+
+TEST_CASE_CONDITIONAL(atomic_increment_latency_matrix, multiple_cpus())
+{
+    latency_matrix(transfer_op::INC, "lock_inc");
+}
+
+TEST_CASE_CONDITIONAL(cas_latency_matrix, multiple_cpus())
+{
+    latency_matrix(transfer_op::CAS, "cas");
+}
+
+TEST_CASE_CONDITIONAL(xchg_latency_matrix, multiple_cpus())
+{
+    latency_matrix(transfer_op::XCHG, "xchg");
+}
+
+/// Returns the TSC ticks per increment if CPU 0 and 1 increment the given counters.
+static uint64_t concurrent_increments(uint64_t& counter_0, uint64_t& counter_1)
+{
+    std::array<uint64_t*, 2> counters{ &counter_0, &counter_1 };
+
+    auto cycles{ run_pair(0, 1, [&counters](uint64_t side) {
+        cbl::in_place_atomic<uint64_t> counter{ *counters[side] };
+        for (uint64_t i{ 0 }; i < INCREMENTS; i++) {
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    }) };
+
+    return cycles / INCREMENTS;
+}
+
+TEST_CASE_CONDITIONAL(false_sharing, multiple_cpus())
+{
+    struct alignas(CPU_CACHE_LINE_SIZE) packed_counters
+    {
+        uint64_t a;
+        uint64_t b;
+    };
+
+    static packed_counters packed;
+    static shared_line separate_a;
+    static shared_line separate_b;
+
+    auto shared_cycles{ concurrent_increments(packed.a, packed.b) };
+    auto separate_cycles{ concurrent_increments(separate_a.value, separate_b.value) };
+
+    BENCHMARK_RESULT("false_sharing_increment", shared_cycles, "cycles");
+    BENCHMARK_RESULT("separate_lines_increment", separate_cycles, "cycles");
+}
+
+TEST_CASE(split_lock)
+{
+    // Two cache lines with a 32-bit counter straddling the boundary.
+    alignas(CPU_CACHE_LINE_SIZE) static char lines[2 * CPU_CACHE_LINE_SIZE];
+    auto& split{ *reinterpret_cast<uint32_t*>(lines + CPU_CACHE_LINE_SIZE - 2) };
+    auto& aligned{ *reinterpret_cast<uint32_t*>(lines) };
+
+    // The compiler emits `lock xadd` regardless of the alignment, so the
+    // split counter causes a bus lock. Hosts with split lock detection may
+    // throttle the vCPU, which is exactly what we want to see here.
+    auto locked_add = [](uint32_t& v) {
+        cbl::in_place_atomic<uint32_t> counter{ v };
+        for (uint64_t i{ 0 }; i < INCREMENTS; i++) {
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    auto start{ rdtsc() };
+    locked_add(aligned);
+    auto aligned_cycles{ (rdtsc() - start) / INCREMENTS };
+
+    start = rdtsc();
+    locked_add(split);
+    auto split_cycles{ (rdtsc() - start) / INCREMENTS };
+
+    BENCHMARK_RESULT("aligned_lock_add", aligned_cycles, "cycles");
+    BENCHMARK_RESULT("split_lock_add", split_cycles, "cycles");
+
+    if (multiple_cpus()) {
+        // With a second CPU hammering on an unrelated line, every bus lock
+        // stalls it as well.
+        alignas(CPU_CACHE_LINE_SIZE) static uint32_t other;
+        auto contended_cycles{ run_pair(0, 1, [&](uint64_t side) {
+            if (side == 0) {
+                locked_add(split);
+            }
+            else {
+                locked_add(other);
+            }
+        }) };
+
+        BENCHMARK_RESULT("split_lock_add_contended", contended_cycles / INCREMENTS, "cycles");
+    }
+}
+
+BARETEST_RUN;
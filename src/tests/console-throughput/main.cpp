@@ -0,0 +1,103 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/console/console_debugcon.hpp>
+#include <toyos/console/console_serial.hpp>
+#include <toyos/console/xhci_console.hpp>
+#include <toyos/printf/backend.hpp>
+#include <toyos/testhelper/tsc_frequency.hpp>
+#include <toyos/util/cpuid.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Measures how fast each console backend takes output, both character by
+// character and in chunks. The lines are written to the device directly, so
+// printf and the other backends are not involved. Like all backend input, the
+// lines already end with \r\n.
+//
+// Each measurement writes many lines back to back. The results are averages
+// per line and per byte and the resulting rate, not the latency of a single
+// write.
+
+static constexpr std::array<size_t, 3> LINE_LENGTHS{ 16, 80, 256 };
+
+// Output per measurement. At 115200 baud, this takes around 1.4s.
+static constexpr size_t BYTES_PER_RUN{ 16 * 1024 };
+
+struct console_backend
+{
+    const char* name;
+    printf_backend_fn putc;
+    printf_write_fn write;
+};
+
+static std::string make_line(size_t length)
+{
+    std::string line{ "console-throughput " };
+    line.resize(length - 2, '.');
+    line += "\r\n";
+    return line;
+}
+
+/// Returns the TSC ticks needed to write the line count times.
+template<typename FN>
+static uint64_t write_lines(const std::string& line, size_t count, FN write_line)
+{
+    auto start{ rdtsc() };
+    for (size_t i{ 0 }; i < count; i++) {
+        write_line(line);
+    }
+    return rdtsc() - start;
+}
+
+static void measure(const console_backend& backend)
+{
+    // Don't let queued output of earlier test cases end up in the measurement.
+    flush_printf_output();
+
+    for (auto length : LINE_LENGTHS) {
+        auto line{ make_line(length) };
+        auto count{ BYTES_PER_RUN / length };
+
+        auto per_char_cycles{ write_lines(line, count, [&backend](const std::string& l) {
+            for (char c : l) {
+                backend.putc(static_cast<unsigned char>(c));
+            }
+        }) };
+
+        auto bulk_cycles{ write_lines(line, count, [&backend](const std::string& l) { backend.write(l.data(), l.size()); }) };
+
+        auto prefix{ std::string(backend.name) + "_" + std::to_string(length) };
+        BENCHMARK_RESULT((prefix + "_putc_line_avg").c_str(), per_char_cycles / count, "cycles");
+        BENCHMARK_RESULT((prefix + "_putc_byte_avg").c_str(), per_char_cycles / (count * length), "cycles");
+        BENCHMARK_RESULT((prefix + "_write_line_avg").c_str(), bulk_cycles / count, "cycles");
+        BENCHMARK_RESULT((prefix + "_write_byte_avg").c_str(), bulk_cycles / (count * length), "cycles");
+
+        if (tsc::frequency_known()) {
+            BENCHMARK_RESULT((prefix + "_putc_rate").c_str(), tsc::bytes_per_s(count * length, per_char_cycles), "B/s");
+            BENCHMARK_RESULT((prefix + "_write_rate").c_str(), tsc::bytes_per_s(count * length, bulk_cycles), "B/s");
+        }
+    }
+}
+
+TEST_CASE_CONDITIONAL(debugcon_throughput, util::cpuid::hv_bit_present())
+{
+    measure({ "debugcon", debugcon::putc, debugcon::write });
+}
+
+TEST_CASE_CONDITIONAL(serial_throughput, console_serial::is_active())
+{
+    measure({ "serial", console_serial::putchar, console_serial::write_buffer });
+}
+
+TEST_CASE_CONDITIONAL(xhci_throughput, xhci_console_base::is_active())
+{
+    measure({ "xhci", xhci_console_base::putchar, xhci_console_base::write_buffer });
+}
+
+BARETEST_RUN;
@@ -49,7 +49,7 @@ std::array<std::string, 9> valid_cpu_models{ {
     "AMD Ryzen 7 PRO ",
 } };
 
-TEST_CASE(cpuid_string_is_native)
+TEST_CASE_CPU_LOCAL(cpuid_string_is_native)
 {
     test_cpuid_string(valid_cpu_models);
 }
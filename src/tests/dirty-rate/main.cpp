@@ -0,0 +1,257 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/boot_cmdline.hpp>
+#include <toyos/cmdline.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/mm.hpp>
+#include <toyos/testhelper/tsc_frequency.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/util/xorshift.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Dirties pages of a large region at a given rate and records how many pages
+// were written in every interval. While the host tracks dirty pages, e.g.
+// during live migration, every first write to a page after the host reset its
+// dirty state costs a VM exit or a PML entry, so the throughput per interval
+// drops. The TSC timestamps of the intervals allow to match the drops with
+// events on the host.
+//
+// One word per page is written, because a single write dirties the page.
+
+// The pages written per second, set with --dirty-rate. 0 writes as fast as
+// possible.
+static uint64_t target_pages_per_s{ 0 };
+
+// The write patterns to run, set with --dirty-patterns. Empty runs all.
+static std::vector<std::string> selected_patterns;
+
+// The length of an interval and of the whole run of each pattern
+static constexpr uint64_t INTERVAL_US{ 100'000 };
+static constexpr uint64_t RUN_US{ 5'000'000 };
+
+// The hot set is this fraction of the region and gets the given share of the writes.
+static constexpr size_t HOT_SET_DIVISOR{ 16 };
+static constexpr uint64_t HOT_SET_PERCENT{ 90 };
+
+// The largest and smallest region that is tried
+static constexpr math::order_t MAX_REGION_ORDER{ math::order_max(1_GiB) };
+static constexpr math::order_t MIN_REGION_ORDER{ math::order_max(64_MiB) };
+
+// Pages that are written between two looks at the TSC
+static constexpr uint64_t BATCH_PAGES{ 16 };
+
+enum class write_pattern
+{
+    SEQUENTIAL,
+    RANDOM,
+    HOT_SET,
+};
+
+// The names --dirty-patterns accepts
+static constexpr std::array<const char*, 3> PATTERN_NAMES{ "sequential", "random", "hot-set" };
+
+struct dirty_region
+{
+    uintptr_t base;
+    math::order_t order;
+
+    size_t pages() const
+    {
+        return size_t(1) << (order - PAGE_BITS);
+    }
+};
+
+static std::optional<dirty_region> region;
+
+/// Parses the --dirty-rate value. std::stoull aborts without a message on bad input.
+static uint64_t parse_dirty_rate(const std::string& rate)
+{
+    // More digits could overflow.
+    static constexpr size_t MAX_DIGITS{ 18 };
+
+    PANIC_UNLESS(not rate.empty() and rate.size() <= MAX_DIGITS
+                     and std::all_of(rate.begin(), rate.end(), [](char c) { return c >= '0' and c <= '9'; }),
+                 "--dirty-rate needs a number of pages per second, got \"{s}\"", rate.c_str());
+    return std::stoull(rate);
+}
+
+void prologue()
+{
+    for (auto order{ MAX_REGION_ORDER }; order >= MIN_REGION_ORDER; order--) {
+        if (auto phys{ alloc_phys(order) }; phys) {
+            region = { uintptr_t(memory_manager::phy_to_lin(*phys)), order };
+            info("Dirtying {} MiB at {#x}", (size_t(1) << order) / 1_MiB, uintptr_t(*phys));
+            break;
+        }
+    }
+
+    cmdline::cmdline_parser parser{ get_boot_cmdline().value_or("") };
+    target_pages_per_s = parse_dirty_rate(parser.dirty_rate_option());
+    selected_patterns = parser.dirty_patterns_option();
+
+    // A typo would silently skip the pattern.
+    for (const auto& name : selected_patterns) {
+        PANIC_UNLESS(std::find_if(PATTERN_NAMES.begin(), PATTERN_NAMES.end(), [&name](const char* n) { return name == n; }) != PATTERN_NAMES.end(),
+                     "Unknown dirty pattern \"{s}\", known are sequential, random and hot-set", name.c_str());
+    }
+
+    if (target_pages_per_s != 0) {
+        info("Dirtying at most {} pages/s", target_pages_per_s);
+    }
+
+    // Calibrate before the first measurement.
+    if (tsc::frequency_known()) {
+        info("TSC runs at {} MHz", tsc::ticks_per_us());
+    }
+    else {
+        info("TSC frequency unknown, skipping the measurements");
+    }
+}
+
+static bool region_available()
+{
+    return region.has_value();
+}
+
+/// Returns true if the pattern runs in this test run.
+static bool pattern_selected(const char* name)
+{
+    // The intervals and the rate limit are defined in time.
+    return region_available() and tsc::frequency_known()
+           and (selected_patterns.empty()
+                or std::find(selected_patterns.begin(), selected_patterns.end(), name) != selected_patterns.end());
+}
+
+/// Picks the pages to write according to a pattern.
+class page_picker
+{
+ public:
+    page_picker(write_pattern pattern, size_t pages)
+        : pattern_(pattern), pages_(pages), hot_pages_(std::max<size_t>(pages / HOT_SET_DIVISOR, 1)) {}
+
+    size_t next()
+    {
+        switch (pattern_) {
+            case write_pattern::SEQUENTIAL:
+                next_ = (next_ + 1) % pages_;
+                return next_;
+            case write_pattern::RANDOM:
+                return rng_.next() % pages_;
+            case write_pattern::HOT_SET:
+                return rng_.next() % 100 < HOT_SET_PERCENT ? rng_.next() % hot_pages_ : rng_.next() % pages_;
+        }
+        __builtin_unreachable();
+    }
+
+ private:
+    write_pattern pattern_;
+    size_t pages_;
+    size_t hot_pages_;
+
+    size_t next_{ 0 };
+    cbl::xorshift rng_{ rdtsc() };
+};
+
+struct interval_record
+{
+    uint64_t start_tsc;
+    uint64_t ticks;
+    uint64_t pages;
+
+    uint64_t pages_per_s() const
+    {
+        return to_pages_per_s(pages, ticks);
+    }
+
+    /// Converts pages written within the given TSC ticks to pages per second.
+    static uint64_t to_pages_per_s(uint64_t pages, uint64_t ticks)
+    {
+        return ticks == 0 ? 0 : pages * 1000000 * tsc::ticks_per_us() / ticks;
+    }
+};
+
+/**
+ * Writes pages for RUN_US and prints the pages written per interval.
+ * Reports the slowest, average and fastest interval in pages per second.
+ */
+static void dirty_pages(const char* name, write_pattern pattern)
+{
+    const auto interval_ticks{ INTERVAL_US * tsc::ticks_per_us() };
+    const auto intervals{ RUN_US / INTERVAL_US };
+
+    std::vector<interval_record> records;
+    records.reserve(intervals);
+
+    page_picker picker{ pattern, region->pages() };
+    uint64_t value{ 0 };
+
+    for (uint64_t i{ 0 }; i < intervals; i++) {
+        const auto start{ rdtsc() };
+        const auto end{ start + interval_ticks };
+        uint64_t pages{ 0 };
+        auto now{ start };
+
+        for (; now < end; now = rdtsc()) {
+            // Stay below the target rate.
+            if (target_pages_per_s != 0 and pages * 1000000 >= (now - start) * target_pages_per_s / tsc::ticks_per_us()) {
+                cpu_pause();
+                continue;
+            }
+
+            for (uint64_t b{ 0 }; b < BATCH_PAGES; b++) {
+                *num_to_ptr<volatile uint64_t>(region->base + picker.next() * PAGE_SIZE) = value++;
+            }
+            pages += BATCH_PAGES;
+        }
+
+        // The last batch usually ends after the interval, and a descheduled
+        // vCPU may overshoot it by far.
+        records.push_back({ start, now - start, pages });
+    }
+
+    for (const auto& r : records) {
+        info("{} tsc {} pages/s {}", name, r.start_tsc, r.pages_per_s());
+    }
+
+    auto [min, max] = std::minmax_element(records.begin(), records.end(),
+                                          [](const auto& a, const auto& b) { return a.pages_per_s() < b.pages_per_s(); });
+    auto total_pages{ std::accumulate(records.begin(), records.end(), uint64_t(0),
+                                      [](uint64_t sum, const auto& r) { return sum + r.pages; }) };
+    auto total_ticks{ std::accumulate(records.begin(), records.end(), uint64_t(0),
+                                      [](uint64_t sum, const auto& r) { return sum + r.ticks; }) };
+
+    auto prefix{ std::string(name) + "_dirty_rate" };
+    BENCHMARK_RESULT((prefix + "_min").c_str(), min->pages_per_s(), "pages/s");
+    BENCHMARK_RESULT((prefix + "_avg").c_str(), interval_record::to_pages_per_s(total_pages, total_ticks), "pages/s");
+    BENCHMARK_RESULT((prefix + "_max").c_str(), max->pages_per_s(), "pages/s");
+}
+
+TEST_CASE_CONDITIONAL(dirty_sequential, pattern_selected("sequential"))
+{
+    dirty_pages("sequential", write_pattern::SEQUENTIAL);
+}
+
+TEST_CASE_CONDITIONAL(dirty_random, pattern_selected("random"))
+{
+    dirty_pages("random", write_pattern::RANDOM);
+}
+
+TEST_CASE_CONDITIONAL(dirty_hot_set, pattern_selected("hot-set"))
+{
+    dirty_pages("hot_set", write_pattern::HOT_SET);
+}
+
+BARETEST_RUN;
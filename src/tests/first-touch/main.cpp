@@ -0,0 +1,129 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/mm.hpp>
+#include <toyos/testhelper/tsc_frequency.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Measures how long it takes to touch guest memory for the first time. The
+// pages come from the usable RAM in the boot memory map and have not been
+// accessed by the guest before, so a host that backs guest memory lazily has
+// to handle an EPT violation, allocate and clear a page, and possibly compact
+// memory for a transparent huge page on every first touch. A second pass over
+// the same pages shows the cost of the access itself.
+//
+// These costs dominate the start-up time of VMs with a lot of memory.
+
+// The amount of memory that is touched at most
+static constexpr uint64_t MAX_TOUCHED_BYTES{ 1_GiB };
+
+// Memory that is left for the heap and page tables
+static constexpr uint64_t SPARE_BYTES{ 16_MiB };
+
+// The memory is collected in blocks of these sizes.
+static constexpr math::order_t MAX_BLOCK_ORDER{ math::order_max(MAX_TOUCHED_BYTES) };
+static constexpr math::order_t MIN_BLOCK_ORDER{ math::order_max(2_MiB) };
+
+struct block
+{
+    phy_addr_t phys;
+    math::order_t order;
+};
+
+static std::vector<block> blocks;
+static std::vector<uintptr_t> pages;
+
+void prologue()
+{
+    info("The boot memory map has {} MiB of usable RAM", boot_memory_map().usable_bytes() / 1_MiB);
+
+    uint64_t collected{ 0 };
+    for (auto order{ MAX_BLOCK_ORDER }; order >= MIN_BLOCK_ORDER;) {
+        auto size{ uint64_t(1) << order };
+        if (collected + size > MAX_TOUCHED_BYTES or free_phys_bytes() < size + SPARE_BYTES) {
+            order--;
+            continue;
+        }
+
+        auto phys{ alloc_phys(order) };
+        if (not phys) {
+            order--;
+            continue;
+        }
+
+        blocks.push_back({ *phys, order });
+        collected += size;
+    }
+
+    // The allocator keeps its bookkeeping in the first page of free blocks,
+    // so only the other pages are untouched.
+    for (const auto& b : blocks) {
+        auto base{ uintptr_t(memory_manager::phy_to_lin(b.phys)) };
+        for (auto page{ base + PAGE_SIZE }; page < base + (uintptr_t(1) << b.order); page += PAGE_SIZE) {
+            pages.push_back(page);
+        }
+    }
+
+    info("Touching {} MiB in {} blocks", pages.size() * PAGE_SIZE / 1_MiB, blocks.size());
+}
+
+static bool pages_available()
+{
+    return not pages.empty();
+}
+
+/**
+ * Writes to every page once and reports the latency distribution of the
+ * writes and the rate at which memory was populated.
+ */
+static void touch_pages(const char* name)
+{
+    static std::vector<uint32_t> latencies;
+    latencies.resize(pages.size());
+
+    auto start{ rdtsc() };
+    for (size_t i{ 0 }; i < pages.size(); i++) {
+        auto before{ rdtsc() };
+        *num_to_ptr<volatile uint64_t>(pages[i]) = i;
+        latencies[i] = uint32_t(std::min<uint64_t>(rdtsc() - before, std::numeric_limits<uint32_t>::max()));
+    }
+    auto cycles{ rdtsc() - start };
+
+    auto percentile = [](size_t p) {
+        auto nth{ latencies.begin() + (latencies.size() - 1) * p / 100 };
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return *nth;
+    };
+
+    auto prefix{ std::string(name) + "_touch" };
+    BENCHMARK_RESULT((prefix + "_avg").c_str(), cycles / pages.size(), "cycles");
+    BENCHMARK_RESULT((prefix + "_p50").c_str(), percentile(50), "cycles");
+    BENCHMARK_RESULT((prefix + "_p99").c_str(), percentile(99), "cycles");
+    BENCHMARK_RESULT((prefix + "_max").c_str(), *std::max_element(latencies.begin(), latencies.end()), "cycles");
+    if (tsc::frequency_known()) {
+        BENCHMARK_RESULT((prefix + "_rate").c_str(), tsc::mb_per_s(pages.size() * PAGE_SIZE, cycles), "MB/s");
+    }
+}
+
+TEST_CASE_CONDITIONAL(populate_memory, pages_available())
+{
+    // Both passes are in one test case, so the second pass never becomes the
+    // first one if a test case is disabled.
+    touch_pages("first");
+    touch_pages("second");
+}
+
+BARETEST_RUN;
@@ -26,7 +26,7 @@ static constexpr zmm_t DESTROY_VAL_512{ DESTROY_VAL, DESTROY_VAL, DESTROY_VAL, D
 
 #define CHECK_FEATURE(features, f) info(#f ": %u", !!(features & f));
 
-TEST_CASE(vector_support)
+TEST_CASE_CPU_LOCAL(vector_support)
 {
     auto features1{ cpuid(CPUID_LEAF_FAMILY_FEATURES) };
 
@@ -82,7 +82,7 @@ static void print_cpuid(uint32_t leaf, uint32_t subleaf)
     info("{#08x} {#08x}: eax={#08x} ebx={#08x} ecx={#08x} edx={#08x}", leaf, subleaf, res.eax, res.ebx, res.ecx, res.edx);
 }
 
-TEST_CASE_CONDITIONAL(xstate_features, xsave_supported())
+TEST_CASE_CPU_LOCAL_CONDITIONAL(xstate_features, xsave_supported())
 {
     uint64_t supported_xstate{ get_supported_xstate() };
 
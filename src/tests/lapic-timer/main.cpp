@@ -9,6 +9,7 @@
 
 #include <optional>
 #include <toyos/baretest/baretest.hpp>
+#include <toyos/binary_trace.hpp>
 #include <toyos/testhelper/irq_handler.hpp>
 #include <toyos/testhelper/irqinfo.hpp>
 #include <toyos/testhelper/lapic_lvt_guard.hpp>
@@ -39,6 +40,10 @@ void calibrating_irq_handler(intr_regs* regs)
 
 void prologue()
 {
+    // Console output between the timer interrupts distorts the measured jitter.
+    baretest::pause_console();
+    binary_trace::prepare();
+
     mask_pic();
     software_apic_enable();
     write_spurious_vector(SPURIOUS_TEST_VECTOR);
@@ -295,7 +300,8 @@ TEST_CASE_CONDITIONAL(deadlines_in_the_past_should_produce_interrupts_immediatel
             enable_interrupts_for_single_instruction();
         } while (!irq_info.valid && (elapsed < maximum_grace_period));
 
-        info("\"Immediate\" interrupt delivery took about {} cycles.", elapsed);
+        // Printing right away would delay the next iteration.
+        deferred_info("\"Immediate\" interrupt delivery took about {} cycles.", elapsed);
         BARETEST_ASSERT(elapsed < maximum_grace_period);
         BARETEST_ASSERT(irq_info.valid);
         BARETEST_ASSERT((static_cast<uint32_t>(irq_info.vec) == MAX_VECTOR));
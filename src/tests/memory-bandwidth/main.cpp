@@ -0,0 +1,417 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/boot_cmdline.hpp>
+#include <toyos/cmdline.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/mm.hpp>
+#include <toyos/testhelper/fpu_guard.hpp>
+#include <toyos/testhelper/tsc_frequency.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/util/xorshift.hpp>
+#include <toyos/x86/x86asm.hpp>
+#include <toyos/x86/x86fpu.hpp>
+
+// Measures the memory bandwidth with the STREAM kernels and the latency of
+// random accesses. Bandwidth that is far below what the host can do, or
+// latency far above it, points to guest memory on the wrong NUMA node,
+// missing huge pages on the host or the overhead of memory encryption.
+//
+// The STREAM kernels work on doubles:
+//   copy:  c = a
+//   scale: b = s * c
+//   add:   c = a + b
+//   triad: a = b + s * c
+//
+// toyOS is built without SSE, so the kernels are written in inline assembly
+// and run within an fpu_guard. Copies with `rep movsb`, which memcpy uses,
+// need no vector registers.
+
+// The size of each of the three arrays. They should be much larger than the
+// last level cache, so smaller arrays are only used if memory is short.
+static constexpr math::order_t MAX_ARRAY_ORDER{ math::order_max(64_MiB) };
+static constexpr math::order_t MIN_ARRAY_ORDER{ math::order_max(8_MiB) };
+
+// Every kernel runs this often and the fastest run is reported.
+static constexpr size_t REPETITIONS{ 5 };
+
+// Working sets of the latency measurement, unless --latency-working-sets
+// lists others to match the cache sizes of the host
+static constexpr std::array<size_t, 6> DEFAULT_LATENCY_WORKING_SETS{ 16_KiB, 256_KiB, 1_MiB, 4_MiB, 16_MiB, 64_MiB };
+
+// Measured accesses per working set after one warm-up round
+static constexpr size_t LATENCY_STEPS{ 1 << 21 };
+
+// The bit patterns of the doubles 1.0, 2.0 and 3.0
+static constexpr uint64_t DOUBLE_ONE{ 0x3ff0000000000000 };
+static constexpr uint64_t DOUBLE_TWO{ 0x4000000000000000 };
+static constexpr uint64_t DOUBLE_THREE{ 0x4008000000000000 };
+
+// The scalar of the scale and triad kernels
+alignas(sizeof(ymm_t)) static constexpr ymm_t SCALAR{ DOUBLE_THREE, DOUBLE_THREE, DOUBLE_THREE, DOUBLE_THREE };
+
+struct stream_arrays
+{
+    uint8_t* a;
+    uint8_t* b;
+    uint8_t* c;
+    math::order_t order;
+
+    size_t bytes() const
+    {
+        return size_t(1) << order;
+    }
+};
+
+static std::optional<stream_arrays> arrays;
+
+static uint8_t* array_at(phy_addr_t phys)
+{
+    return num_to_ptr<uint8_t>(uintptr_t(memory_manager::phy_to_lin(phys)));
+}
+
+static void fill(uint8_t* array, size_t bytes, uint64_t pattern)
+{
+    auto* words{ reinterpret_cast<uint64_t*>(array) };
+    std::fill(words, words + bytes / sizeof(uint64_t), pattern);
+}
+
+void prologue()
+{
+    for (auto order{ MAX_ARRAY_ORDER }; order >= MIN_ARRAY_ORDER; order--) {
+        auto a{ alloc_phys(order) };
+        auto b{ alloc_phys(order) };
+        auto c{ alloc_phys(order) };
+
+        if (a and b and c) {
+            arrays = { array_at(*a), array_at(*b), array_at(*c), order };
+            break;
+        }
+
+        for (const auto& phys : { a, b, c }) {
+            if (phys) {
+                free_phys(*phys, order);
+            }
+        }
+    }
+
+    if (not arrays) {
+        return;
+    }
+
+    info("Using 3 arrays of {} MiB", arrays->bytes() / 1_MiB);
+
+    fill(arrays->a, arrays->bytes(), DOUBLE_ONE);
+    fill(arrays->b, arrays->bytes(), DOUBLE_TWO);
+    fill(arrays->c, arrays->bytes(), 0);
+
+    // Calibrate before the first measurement.
+    if (tsc::frequency_known()) {
+        info("TSC runs at {} MHz", tsc::ticks_per_us());
+    }
+    else {
+        info("TSC frequency unknown, reporting cycles");
+    }
+}
+
+static bool arrays_available()
+{
+    return arrays.has_value();
+}
+
+struct stream_kernel
+{
+    const char* name;
+    void (*fn)(const stream_arrays& s);
+
+    // Arrays that are read or written
+    size_t arrays_touched;
+};
+
+/// Runs every kernel and reports the bandwidth of its fastest run.
+template<size_t N>
+static void run_kernels(const char* variant, const std::array<stream_kernel, N>& kernels)
+{
+    for (const auto& kernel : kernels) {
+        auto best{ std::numeric_limits<uint64_t>::max() };
+        for (size_t i{ 0 }; i < REPETITIONS; i++) {
+            auto start{ rdtsc() };
+            kernel.fn(*arrays);
+            best = std::min(best, rdtsc() - start);
+        }
+
+        auto name{ std::string(variant) + "_" + kernel.name };
+        if (tsc::frequency_known()) {
+            auto bytes{ kernel.arrays_touched * arrays->bytes() };
+            BENCHMARK_RESULT(name.c_str(), tsc::mb_per_s(bytes, best), "MB/s");
+        }
+        else {
+            BENCHMARK_RESULT((name + "_cycles").c_str(), best, "cycles");
+        }
+    }
+}
+
+TEST_CASE_CONDITIONAL(stream_rep_movsb, arrays_available())
+{
+    static constexpr std::array<stream_kernel, 1> kernels{
+        { { "copy", [](const stream_arrays& s) { memcpy(s.c, s.a, s.bytes()); }, 2 } },
+    };
+    run_kernels("rep_movsb", kernels);
+}
+
+// Every step of the SSE kernels works on 32 bytes.
+static constexpr size_t SSE_STEP{ 2 * sizeof(xmm_t) };
+
+static void copy_sse(const stream_arrays& s)
+{
+    auto *a{ s.a }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += SSE_STEP) {
+        asm volatile("movapd   (%[a]), %%xmm0\n"
+                     "movapd 16(%[a]), %%xmm1\n"
+                     "movapd %%xmm0,   (%[c])\n"
+                     "movapd %%xmm1, 16(%[c])\n"
+                     :
+                     : [a] "r"(a + i), [c] "r"(c + i)
+                     : "memory");
+    }
+}
+
+static void scale_sse(const stream_arrays& s)
+{
+    auto *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += SSE_STEP) {
+        asm volatile("movapd   (%[c]), %%xmm0\n"
+                     "movapd 16(%[c]), %%xmm1\n"
+                     "mulpd %[s], %%xmm0\n"
+                     "mulpd %[s], %%xmm1\n"
+                     "movapd %%xmm0,   (%[b])\n"
+                     "movapd %%xmm1, 16(%[b])\n"
+                     :
+                     : [b] "r"(b + i), [c] "r"(c + i), [s] "m"(SCALAR)
+                     : "memory");
+    }
+}
+
+static void add_sse(const stream_arrays& s)
+{
+    auto *a{ s.a }, *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += SSE_STEP) {
+        asm volatile("movapd   (%[a]), %%xmm0\n"
+                     "movapd 16(%[a]), %%xmm1\n"
+                     "addpd   (%[b]), %%xmm0\n"
+                     "addpd 16(%[b]), %%xmm1\n"
+                     "movapd %%xmm0,   (%[c])\n"
+                     "movapd %%xmm1, 16(%[c])\n"
+                     :
+                     : [a] "r"(a + i), [b] "r"(b + i), [c] "r"(c + i)
+                     : "memory");
+    }
+}
+
+static void triad_sse(const stream_arrays& s)
+{
+    auto *a{ s.a }, *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += SSE_STEP) {
+        asm volatile("movapd   (%[c]), %%xmm0\n"
+                     "movapd 16(%[c]), %%xmm1\n"
+                     "mulpd %[s], %%xmm0\n"
+                     "mulpd %[s], %%xmm1\n"
+                     "addpd   (%[b]), %%xmm0\n"
+                     "addpd 16(%[b]), %%xmm1\n"
+                     "movapd %%xmm0,   (%[a])\n"
+                     "movapd %%xmm1, 16(%[a])\n"
+                     :
+                     : [a] "r"(a + i), [b] "r"(b + i), [c] "r"(c + i), [s] "m"(SCALAR)
+                     : "memory");
+    }
+}
+
+TEST_CASE_CONDITIONAL(stream_sse, arrays_available())
+{
+    static constexpr std::array<stream_kernel, 4> kernels{ {
+        { "copy", copy_sse, 2 },
+        { "scale", scale_sse, 2 },
+        { "add", add_sse, 3 },
+        { "triad", triad_sse, 3 },
+    } };
+
+    fpu_guard _;
+    run_kernels("sse", kernels);
+}
+
+// Every step of the AVX kernels works on 64 bytes.
+static constexpr size_t AVX_STEP{ 2 * sizeof(ymm_t) };
+
+static void copy_avx(const stream_arrays& s)
+{
+    auto *a{ s.a }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += AVX_STEP) {
+        asm volatile("vmovapd   (%[a]), %%ymm0\n"
+                     "vmovapd 32(%[a]), %%ymm1\n"
+                     "vmovapd %%ymm0,   (%[c])\n"
+                     "vmovapd %%ymm1, 32(%[c])\n"
+                     :
+                     : [a] "r"(a + i), [c] "r"(c + i)
+                     : "memory");
+    }
+}
+
+static void scale_avx(const stream_arrays& s)
+{
+    auto *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += AVX_STEP) {
+        asm volatile("vmovapd %[s], %%ymm2\n"
+                     "vmulpd   (%[c]), %%ymm2, %%ymm0\n"
+                     "vmulpd 32(%[c]), %%ymm2, %%ymm1\n"
+                     "vmovapd %%ymm0,   (%[b])\n"
+                     "vmovapd %%ymm1, 32(%[b])\n"
+                     :
+                     : [b] "r"(b + i), [c] "r"(c + i), [s] "m"(SCALAR)
+                     : "memory");
+    }
+}
+
+static void add_avx(const stream_arrays& s)
+{
+    auto *a{ s.a }, *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += AVX_STEP) {
+        asm volatile("vmovapd   (%[a]), %%ymm0\n"
+                     "vmovapd 32(%[a]), %%ymm1\n"
+                     "vaddpd   (%[b]), %%ymm0, %%ymm0\n"
+                     "vaddpd 32(%[b]), %%ymm1, %%ymm1\n"
+                     "vmovapd %%ymm0,   (%[c])\n"
+                     "vmovapd %%ymm1, 32(%[c])\n"
+                     :
+                     : [a] "r"(a + i), [b] "r"(b + i), [c] "r"(c + i)
+                     : "memory");
+    }
+}
+
+static void triad_avx(const stream_arrays& s)
+{
+    auto *a{ s.a }, *b{ s.b }, *c{ s.c };
+    for (size_t i{ 0 }, end{ s.bytes() }; i < end; i += AVX_STEP) {
+        asm volatile("vmovapd %[s], %%ymm2\n"
+                     "vmulpd   (%[c]), %%ymm2, %%ymm0\n"
+                     "vmulpd 32(%[c]), %%ymm2, %%ymm1\n"
+                     "vaddpd   (%[b]), %%ymm0, %%ymm0\n"
+                     "vaddpd 32(%[b]), %%ymm1, %%ymm1\n"
+                     "vmovapd %%ymm0,   (%[a])\n"
+                     "vmovapd %%ymm1, 32(%[a])\n"
+                     :
+                     : [a] "r"(a + i), [b] "r"(b + i), [c] "r"(c + i), [s] "m"(SCALAR)
+                     : "memory");
+    }
+}
+
+TEST_CASE_CONDITIONAL(stream_avx, arrays_available() and fpu_guard::avx_usable())
+{
+    static constexpr std::array<stream_kernel, 4> kernels{ {
+        { "copy", copy_avx, 2 },
+        { "scale", scale_avx, 2 },
+        { "add", add_avx, 3 },
+        { "triad", triad_avx, 3 },
+    } };
+
+    fpu_guard _;
+    run_kernels("avx", kernels);
+    asm volatile("vzeroupper");
+}
+
+/**
+ * Links all cache lines of the working set at the start of array a to a
+ * single cycle in random order. Every line holds the address of the next one.
+ *
+ * \return The address of the first line.
+ */
+static uintptr_t build_chain(size_t working_set)
+{
+    auto lines{ working_set / CPU_CACHE_LINE_SIZE };
+
+    // Sattolo's algorithm yields a permutation that is a single cycle.
+    std::vector<uint32_t> order(lines);
+    for (size_t i{ 0 }; i < lines; i++) {
+        order[i] = uint32_t(i);
+    }
+
+    cbl::xorshift rng{ rdtsc() };
+    for (size_t i{ lines - 1 }; i > 0; i--) {
+        std::swap(order[i], order[rng.next() % i]);
+    }
+
+    auto base{ ptr_to_num(arrays->a) };
+    for (size_t i{ 0 }; i < lines; i++) {
+        auto next{ order[(i + 1) % lines] };
+        *num_to_ptr<uintptr_t>(base + order[i] * CPU_CACHE_LINE_SIZE) = base + next * CPU_CACHE_LINE_SIZE;
+    }
+
+    return base + order[0] * CPU_CACHE_LINE_SIZE;
+}
+
+static uintptr_t chase(uintptr_t line, size_t steps)
+{
+    for (size_t i{ 0 }; i < steps; i++) {
+        line = *num_to_ptr<volatile uintptr_t>(line);
+    }
+    return line;
+}
+
+/// Returns the working sets of the latency measurement in bytes.
+static std::vector<size_t> latency_working_sets()
+{
+    auto option{ cmdline::cmdline_parser(get_boot_cmdline().value_or("")).latency_working_sets_option() };
+    if (option.empty()) {
+        return { DEFAULT_LATENCY_WORKING_SETS.begin(), DEFAULT_LATENCY_WORKING_SETS.end() };
+    }
+
+    std::vector<size_t> working_sets;
+    for (const auto& kib : option) {
+        working_sets.push_back(std::stoull(kib) * 1_KiB);
+        PANIC_UNLESS(working_sets.back() != 0, "Invalid latency working set: {s}", kib.c_str());
+    }
+    return working_sets;
+}
+
+TEST_CASE_CONDITIONAL(random_access_latency, arrays_available())
+{
+    for (auto working_set : latency_working_sets()) {
+        if (working_set > arrays->bytes()) {
+            info("Skipping {} KiB, the arrays only have {} KiB", working_set / 1_KiB, arrays->bytes() / 1_KiB);
+            continue;
+        }
+
+        auto line{ chase(build_chain(working_set), working_set / CPU_CACHE_LINE_SIZE) };
+
+        auto start{ rdtsc() };
+        line = chase(line, LATENCY_STEPS);
+        auto cycles{ rdtsc() - start };
+
+        PANIC_UNLESS(line - ptr_to_num(arrays->a) < working_set, "Chain left the working set: {#x}", line);
+
+        auto name{ "random_access_" + std::to_string(working_set / 1_KiB) + "KiB" };
+        if (tsc::frequency_known()) {
+            BENCHMARK_RESULT((name + "_latency").c_str(), tsc::ticks_to_ns(cycles) / LATENCY_STEPS, "ns");
+        }
+        else {
+            BENCHMARK_RESULT((name + "_latency_cycles").c_str(), cycles / LATENCY_STEPS, "cycles");
+        }
+    }
+
+    // The STREAM kernels expect doubles in array a again.
+    fill(arrays->a, arrays->bytes(), DOUBLE_ONE);
+}
+
+BARETEST_RUN;
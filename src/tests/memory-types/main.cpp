@@ -0,0 +1,217 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/mm.hpp>
+#include <toyos/testhelper/tsc_frequency.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+#include <toyos/x86/x86defs.hpp>
+
+using namespace x86;
+
+// Measures the read and write bandwidth of one buffer with every memory type
+// that the PAT offers. The differences between the types are large, so a
+// hypervisor that ignores the guest memory type, e.g. by forcing WB or UC for
+// assigned device memory, stands out immediately.
+//
+// The buffer is remapped in place, so there is never a second mapping of it
+// with another memory type. The effective memory type also depends on the
+// MTRRs, which are expected to make RAM WB.
+
+// The memory types in PAT entries
+enum pat_type : uint64_t
+{
+    PAT_UC = 0,
+    PAT_WC = 1,
+    PAT_WT = 4,
+    PAT_WP = 5,
+    PAT_WB = 6,
+    PAT_UC_MINUS = 7,
+};
+
+static constexpr uint64_t pat_entry(size_t index, pat_type type)
+{
+    return uint64_t(type) << (8 * index);
+}
+
+// PA0 - PA3 keep their default, so the boot page tables don't change their
+// meaning. WC and WP go to PA4 and PA5.
+static constexpr uint64_t BENCHMARK_PAT{ pat_entry(0, PAT_WB) | pat_entry(1, PAT_WT) | pat_entry(2, PAT_UC_MINUS)
+                                         | pat_entry(3, PAT_UC) | pat_entry(4, PAT_WC) | pat_entry(5, PAT_WP)
+                                         | pat_entry(6, PAT_UC_MINUS) | pat_entry(7, PAT_UC) };
+
+struct cache_type
+{
+    const char* name;
+
+    // The PAT entry, which is selected by the PAT, PCD and PWT bits
+    size_t pat_index;
+};
+
+static constexpr std::array<cache_type, 5> CACHE_TYPES{ {
+    { "uc", 3 },
+    { "wc", 4 },
+    { "wt", 1 },
+    { "wp", 5 },
+    { "wb", 0 },
+} };
+
+// The largest and smallest buffer that is tried. UC accesses are slow, so
+// the buffer is kept small.
+static constexpr math::order_t MAX_BUFFER_ORDER{ math::order_max(16_MiB) };
+static constexpr math::order_t MIN_BUFFER_ORDER{ math::order_max(2_MiB) };
+
+// Every measurement runs this often and the fastest run is reported.
+static constexpr size_t REPETITIONS{ 3 };
+
+struct benchmark_buffer
+{
+    phy_addr_t phys;
+    math::order_t order;
+
+    uintptr_t lin() const
+    {
+        return uintptr_t(memory_manager::phy_to_lin(phys));
+    }
+
+    size_t bytes() const
+    {
+        return size_t(1) << order;
+    }
+};
+
+static std::optional<benchmark_buffer> buffer;
+static uint64_t original_pat{ 0 };
+
+static bool pat_supported()
+{
+    return cpuid(CPUID_LEAF_FAMILY_FEATURES).edx & LVL_0000_0001_EDX_PAT;
+}
+
+/// Changes the PAT as the SDM demands: without stale cache lines or TLB entries.
+static void set_pat(uint64_t pat)
+{
+    wbinvd();
+    wrmsr(msr::PAT, pat);
+    wbinvd();
+    memory_manager::invalidate_tlb_all();
+}
+
+void prologue()
+{
+    if (not pat_supported()) {
+        return;
+    }
+
+    for (auto order{ MAX_BUFFER_ORDER }; order >= MIN_BUFFER_ORDER; order--) {
+        if (auto phys{ alloc_phys(order) }; phys) {
+            buffer = { *phys, order };
+            break;
+        }
+    }
+
+    info("MTRR default type: {#x}", rdmsr(msr::MTRR_DEF_TYPE));
+    if (tsc::frequency_known()) {
+        info("TSC runs at {} MHz", tsc::ticks_per_us());
+    }
+    else {
+        info("TSC frequency unknown, reporting cycles");
+    }
+
+    original_pat = rdmsr(msr::PAT);
+    set_pat(BENCHMARK_PAT);
+}
+
+void epilogue()
+{
+    if (pat_supported()) {
+        set_pat(original_pat);
+    }
+}
+
+static bool buffer_available()
+{
+    return buffer.has_value();
+}
+
+/// Maps the buffer in place with the given PAT entry.
+static void map_buffer(size_t pat_index)
+{
+    memory_manager::mapping_attributes attrs;
+    attrs.pwt = pat_index & 1;
+    attrs.pcd = pat_index & 2;
+    attrs.pat = pat_index & 4;
+
+    // No cache line of the old memory type may survive the change.
+    wbinvd();
+    memory_manager::map_range(lin_addr_t(buffer->lin()), buffer->phys, buffer->bytes(), attrs);
+    wbinvd();
+}
+
+/// Runs fn on cold caches and returns the TSC ticks of the fastest run.
+template<typename FN>
+static uint64_t fastest_run(FN fn)
+{
+    auto best{ std::numeric_limits<uint64_t>::max() };
+    for (size_t i{ 0 }; i < REPETITIONS; i++) {
+        wbinvd();
+        auto start{ rdtsc() };
+        fn();
+        best = std::min(best, rdtsc() - start);
+    }
+    return best;
+}
+
+static void read_buffer()
+{
+    auto* words{ num_to_ptr<volatile uint64_t>(buffer->lin()) };
+    uint64_t sum{ 0 };
+    for (size_t i{ 0 }; i < buffer->bytes() / sizeof(uint64_t); i++) {
+        sum += words[i];
+    }
+    asm volatile("" ::"r"(sum));
+}
+
+static void write_buffer()
+{
+    auto* words{ num_to_ptr<volatile uint64_t>(buffer->lin()) };
+    for (size_t i{ 0 }; i < buffer->bytes() / sizeof(uint64_t); i++) {
+        words[i] = i;
+    }
+}
+
+TEST_CASE_CONDITIONAL(memory_type_bandwidth, buffer_available())
+{
+    for (const auto& type : CACHE_TYPES) {
+        map_buffer(type.pat_index);
+
+        auto read_ticks{ fastest_run(read_buffer) };
+        auto write_ticks{ fastest_run(write_buffer) };
+
+        if (tsc::frequency_known()) {
+            BENCHMARK_RESULT((std::string(type.name) + "_read").c_str(), tsc::mb_per_s(buffer->bytes(), read_ticks), "MB/s");
+            BENCHMARK_RESULT((std::string(type.name) + "_write").c_str(), tsc::mb_per_s(buffer->bytes(), write_ticks), "MB/s");
+        }
+        else {
+            BENCHMARK_RESULT((std::string(type.name) + "_read_cycles").c_str(), read_ticks, "cycles");
+            BENCHMARK_RESULT((std::string(type.name) + "_write_cycles").c_str(), write_ticks, "cycles");
+        }
+    }
+
+    // The last type is WB, which is what the rest of the memory uses.
+    map_buffer(CACHE_TYPES.back().pat_index);
+}
+
+BARETEST_RUN;
@@ -97,7 +97,7 @@ TEST_CASE(reconfigure_page_attribute_table)
     BARETEST_ASSERT(rdmsr(msr::PAT) == pat);
 }
 
-TEST_CASE(rdtscp_returns_correct_tsc_aux_value_in_rcx)
+TEST_CASE_CPU_LOCAL(rdtscp_returns_correct_tsc_aux_value_in_rcx)
 {
     auto aux_val{ rdmsr(IA32_TSC_AUX) + 0x42 };
     wrmsr(IA32_TSC_AUX, aux_val);
@@ -111,19 +111,19 @@ TEST_CASE(rdtscp_returns_correct_tsc_aux_value_in_rcx)
 }
 
 // This MSR is Intel-specific.
-TEST_CASE_CONDITIONAL(platform_info_is_correctly_initialized_non_zero, util::cpuid::is_intel_cpu())
+TEST_CASE_CPU_LOCAL_CONDITIONAL(platform_info_is_correctly_initialized_non_zero, util::cpuid::is_intel_cpu())
 {
     uint64_t platform_info{ rdmsr(MSR_PLATFORM_INFO) };
     BARETEST_ASSERT(platform_info != 0);
 }
 
-TEST_CASE(mtrr_cap_valid)
+TEST_CASE_CPU_LOCAL(mtrr_cap_valid)
 {
     auto mtrr_cap{ rdmsr(msr::MTRR_CAP) };
     info("MTRR_CAP: {#x}", mtrr_cap);
 }
 
-TEST_CASE(fixed_mtrrs_valid)
+TEST_CASE_CPU_LOCAL(fixed_mtrrs_valid)
 {
     const std::initializer_list<msr> msrs_mtrr{
         msr::MTRR_FIX_64K_00000,
@@ -148,7 +148,7 @@ TEST_CASE(fixed_mtrrs_valid)
     }
 }
 
-TEST_CASE(variable_range_mtrrs_valid)
+TEST_CASE_CPU_LOCAL(variable_range_mtrrs_valid)
 {
     auto mtrr_cap{ rdmsr(msr::MTRR_CAP) };
 
@@ -172,7 +172,7 @@ TEST_CASE(variable_range_mtrrs_valid)
     }
 }
 
-TEST_CASE(mtrr_def_type_valid)
+TEST_CASE_CPU_LOCAL(mtrr_def_type_valid)
 {
     auto mtrr_def_type{ rdmsr(msr::MTRR_DEF_TYPE) };
     info("MTRR_DEF_TYPE: {#x}", mtrr_def_type);
@@ -0,0 +1,179 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/memory/system_memory.hpp>
+#include <toyos/mm.hpp>
+#include <toyos/util/cast_helpers.hpp>
+#include <toyos/util/cpuid.hpp>
+#include <toyos/util/literals.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/util/xorshift.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Measures the cost of TLB misses with 4 KiB, 2 MiB and 1 GiB pages. The same
+// buffer is mapped once per page size and a pointer chain that visits one
+// random cache line per page in random order is followed through each mapping.
+//
+// The working sets are chosen to fit into the L1 dTLB, into the STLB and to
+// exceed both. The data touched is the same for all page sizes, so the
+// differences between them are the page walks. Under nested paging, every
+// walk also walks the host page tables, so the results show how expensive
+// two-dimensional walks are and whether the host backs the guest with large
+// pages.
+
+// Working set sizes in pages, capped to the buffer size
+static constexpr std::array<size_t, 4> WORKING_SET_PAGES{ 16, 512, 8192, 65536 };
+
+// The largest and smallest buffer that is tried
+static constexpr math::order_t MAX_BUFFER_ORDER{ math::order_max(256_MiB) };
+static constexpr math::order_t MIN_BUFFER_ORDER{ math::order_max(16_MiB) };
+
+// Measured steps per working set after one warm-up round through the chain
+static constexpr size_t CHASE_STEPS{ 1 << 20 };
+
+// The windows through which the buffer is accessed. They are in PML4 slots
+// that the boot page tables don't use.
+static constexpr uintptr_t WINDOW_4K{ 1_TiB };
+static constexpr uintptr_t WINDOW_2M{ 2_TiB };
+static constexpr uintptr_t WINDOW_1G{ 3_TiB };
+
+struct chase_buffer
+{
+    phy_addr_t phys;
+    math::order_t order;
+
+    size_t pages() const
+    {
+        return size_t(1) << (order - PAGE_BITS);
+    }
+};
+
+static std::optional<chase_buffer> buffer;
+
+void prologue()
+{
+    for (auto order{ MAX_BUFFER_ORDER }; order >= MIN_BUFFER_ORDER; order--) {
+        if (auto phys{ alloc_phys(order) }; phys) {
+            buffer = { *phys, order };
+            info("Chasing through {} MiB at {#x}", (size_t(1) << order) / 1_MiB, uintptr_t(*phys));
+            return;
+        }
+    }
+}
+
+static bool buffer_available()
+{
+    return buffer.has_value();
+}
+
+/**
+ * Links one random cache line of each of the first pages of the buffer to a
+ * single cycle in random order. Every line holds the buffer offset of the
+ * next one, so the chain works through every mapping of the buffer.
+ *
+ * \return The offset of the first line of the chain.
+ */
+static uint64_t build_chain(size_t pages)
+{
+    // Sattolo's algorithm yields a permutation that is a single cycle.
+    std::vector<uint32_t> order(pages);
+    for (size_t i{ 0 }; i < pages; i++) {
+        order[i] = uint32_t(i);
+    }
+
+    cbl::xorshift rng{ rdtsc() };
+    for (size_t i{ pages - 1 }; i > 0; i--) {
+        std::swap(order[i], order[rng.next() % i]);
+    }
+
+    static constexpr size_t LINES_PER_PAGE{ PAGE_SIZE / CPU_CACHE_LINE_SIZE };
+
+    std::vector<uint64_t> offsets(pages);
+    for (size_t i{ 0 }; i < pages; i++) {
+        offsets[i] = uint64_t(order[i]) * PAGE_SIZE + (rng.next() % LINES_PER_PAGE) * CPU_CACHE_LINE_SIZE;
+    }
+
+    auto base{ uintptr_t(memory_manager::phy_to_lin(buffer->phys)) };
+    for (size_t i{ 0 }; i < pages; i++) {
+        *num_to_ptr<uint64_t>(base + offsets[i]) = offsets[(i + 1) % pages];
+    }
+
+    return offsets[0];
+}
+
+/// Follows the chain for the given number of steps and returns where it stopped.
+static uint64_t chase(uintptr_t base, uint64_t offset, size_t steps)
+{
+    for (size_t i{ 0 }; i < steps; i++) {
+        offset = *num_to_ptr<volatile uint64_t>(base + offset);
+    }
+    return offset;
+}
+
+/**
+ * Maps the buffer at the given window with pages of at most the given order
+ * and reports the chasing latency for all working sets.
+ *
+ * \param window     The linear address at which the buffer is accessed.
+ * \param phys       The first physical address that is mapped at the window.
+ * \param size       The size of the mapping.
+ * \param page_order The page size to map with.
+ */
+static void measure(const char* name, uintptr_t window, phy_addr_t phys, size_t size, math::order_t page_order)
+{
+    memory_manager::mapping_attributes attrs;
+    attrs.max_page_order = page_order;
+    memory_manager::map_range(lin_addr_t(window), phys, size, attrs);
+
+    auto base{ window + (uintptr_t(buffer->phys) - uintptr_t(phys)) };
+
+    for (auto pages : WORKING_SET_PAGES) {
+        // A capped working set would report a duplicate of the last result.
+        if (pages > buffer->pages()) {
+            info("Skipping {} pages, the buffer only has {}", pages, buffer->pages());
+            continue;
+        }
+
+        auto start_offset{ build_chain(pages) };
+        auto offset{ chase(base, start_offset, pages) };
+
+        auto start{ rdtsc() };
+        offset = chase(base, offset, CHASE_STEPS);
+        auto cycles{ rdtsc() - start };
+
+        PANIC_UNLESS(offset < pages * PAGE_SIZE, "Chain left the working set: {#x}", offset);
+
+        BENCHMARK_RESULT((std::string(name) + "_" + std::to_string(pages) + "_pages_chase").c_str(), cycles / CHASE_STEPS, "cycles");
+    }
+}
+
+TEST_CASE_CONDITIONAL(chase_4k_pages, buffer_available())
+{
+    measure("4k", WINDOW_4K, buffer->phys, size_t(1) << buffer->order, PAGE_BITS);
+}
+
+TEST_CASE_CONDITIONAL(chase_2m_pages, buffer_available())
+{
+    measure("2m", WINDOW_2M, buffer->phys, size_t(1) << buffer->order, math::order_max(2_MiB));
+}
+
+TEST_CASE_CONDITIONAL(chase_1g_pages, buffer_available() and util::cpuid::has_1gb_pages())
+{
+    // The buffer is smaller than a 1 GiB page, so the whole surrounding
+    // gigabyte is mapped.
+    static constexpr math::order_t ORDER_1G{ math::order_max(1_GiB) };
+    auto phys{ phy_addr_t(math::align_down(uintptr_t(buffer->phys), ORDER_1G)) };
+
+    measure("1g", WINDOW_1G, phys, 1_GiB, ORDER_1G);
+}
+
+BARETEST_RUN;
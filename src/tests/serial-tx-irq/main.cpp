@@ -0,0 +1,108 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cstdint>
+
+#include <config.hpp>
+#include <toyos/baretest/assert.hpp>
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/console/console_serial.hpp>
+#include <toyos/testhelper/ioapic.hpp>
+#include <toyos/testhelper/irq_handler.hpp>
+#include <toyos/testhelper/lapic_test_tools.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Runs the serial console in interrupt-driven mode: output is queued in the
+// transmit ring and the THRE interrupt refills the UART FIFO from it.
+//
+// The serial IRQ is expected at the I/O APIC pin of the legacy COM1 IRQ.
+
+using redirection_entry = ioapic::redirection_entry;
+
+static constexpr uint8_t SERIAL_VECTOR{ 0x40 };
+
+// Lines printed while transmission is interrupt-driven
+static constexpr unsigned LINES{ 64 };
+
+// Polls for the transmit ring to drain before giving up
+static constexpr uint64_t DRAIN_RETRIES{ 100'000'000 };
+
+static volatile uint64_t serial_irqs{ 0 };
+static volatile uint64_t unexpected_irqs{ 0 };
+
+static void serial_irq_handler(intr_regs* regs)
+{
+    if (regs->vector != SERIAL_VECTOR) {
+        unexpected_irqs++;
+        return;
+    }
+
+    serial_irqs++;
+    console_serial::active()->handle_irq();
+    lapic_test_tools::send_eoi();
+}
+
+static void route_serial_irq(bool enabled)
+{
+    redirection_entry entry(SERIAL_IRQ_DEFAULT,
+                            SERIAL_VECTOR,
+                            0 /* BSP: physical destination mode */,
+                            redirection_entry::dlv_mode::FIXED,
+                            redirection_entry::trigger_mode::EDGE);
+    if (not enabled) {
+        entry.mask();
+    }
+    ioapic().set_irt(entry);
+}
+
+void prologue()
+{
+    if (not console_serial::is_active()) {
+        return;
+    }
+
+    irq_handler::set(serial_irq_handler);
+    if (not lapic_test_tools::software_apic_enabled()) {
+        lapic_test_tools::software_apic_enable();
+    }
+    route_serial_irq(true);
+}
+
+void epilogue()
+{
+    if (console_serial::is_active()) {
+        route_serial_irq(false);
+    }
+}
+
+TEST_CASE_CONDITIONAL(tx_irq_mode_drains_ring, console_serial::is_active())
+{
+    auto* serial{ console_serial::active() };
+    serial_irqs = 0;
+    unexpected_irqs = 0;
+
+    serial->set_tx_irq_mode(true);
+    enable_interrupts();
+
+    for (unsigned i{ 0 }; i < LINES; i++) {
+        info("interrupt-driven line {} of {}", i + 1, LINES);
+    }
+
+    bool drained{ false };
+    for (uint64_t retry{ 0 }; retry < DRAIN_RETRIES and not drained; retry++) {
+        drained = not serial->tx_pending();
+        cpu_pause();
+    }
+
+    disable_interrupts();
+    serial->set_tx_irq_mode(false);
+
+    info("{} serial interrupts", serial_irqs);
+    BARETEST_ASSERT(drained);
+    BARETEST_ASSERT(serial_irqs > 0);
+    BARETEST_ASSERT(unexpected_irqs == 0);
+}
+
+BARETEST_RUN;
@@ -29,7 +29,9 @@ TEST_CASE(tsc_is_monotonous)
 
         const uint64_t tsc_after{ rdtsc() };
 
-        // Be verbose for debugging.
+        // Be verbose for debugging. Unlike the tsc test, this one leaves the
+        // console running: the output is outside of the measured loop, and
+        // whoever pauses the VM wants to see the progress while it runs.
         info("{}: TSC {} - {} = {}", round, tsc_after, tsc_before, tsc_after - tsc_before);
 
         BARETEST_ASSERT(tsc_before < tsc_after);
@@ -86,4 +86,10 @@ TEST_CASE_CONDITIONAL(local_apic_timer_uses_tsc_as_configured, supports_tsc_dead
     }
 }
 
+void prologue()
+{
+    // Console accesses may exit to the VMM, which perturbs the TSC checks.
+    baretest::pause_console();
+}
+
 BARETEST_RUN;
@@ -0,0 +1,93 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cstdint>
+#include <vector>
+
+#include <toyos/baretest/assert.hpp>
+#include <toyos/baretest/baretest.hpp>
+#include <toyos/per_cpu.hpp>
+#include <toyos/smp.hpp>
+#include <toyos/util/trace.hpp>
+#include <toyos/work_stealing.hpp>
+#include <toyos/x86/x86asm.hpp>
+
+// Runs tasks through the work-stealing scheduler on all CPUs. Besides
+// checking that every task runs exactly once, the steal count and the load
+// imbalance show how evenly the host schedules the vCPUs: a vCPU that is
+// descheduled leaves its tasks to the others.
+
+static constexpr size_t TASKS_PER_CPU{ 256 };
+
+// The TSC ticks a task keeps its CPU busy
+static constexpr uint64_t TASK_TICKS{ 100'000 };
+
+void prologue()
+{
+    smp::start_aps();
+}
+
+static bool multiple_cpus()
+{
+    return online_cpus() > 1;
+}
+
+static void busy_wait(uint64_t ticks)
+{
+    auto end{ rdtsc() + ticks };
+    while (rdtsc() < end) {
+        cpu_pause();
+    }
+}
+
+/// Checks that every task ran exactly once and that the statistics account for all of them.
+static void check_run(const smp::task_run_stats& stats, const std::vector<uint32_t>& runs)
+{
+    for (auto count : runs) {
+        BARETEST_ASSERT(count == 1);
+    }
+
+    BARETEST_ASSERT(stats.cpus.size() == online_cpus());
+
+    uint64_t executed{ 0 };
+    for (const auto& cpu : stats.cpus) {
+        BARETEST_ASSERT(cpu.stolen <= cpu.executed);
+        executed += cpu.executed;
+    }
+    BARETEST_ASSERT(executed == runs.size());
+    BARETEST_ASSERT(stats.steals() <= executed);
+}
+
+TEST_CASE(uniform_tasks)
+{
+    std::vector<uint32_t> runs(TASKS_PER_CPU * online_cpus(), 0);
+
+    auto stats{ smp::run_tasks(runs.size(), [&runs](size_t task) {
+        __atomic_add_fetch(&runs[task], 1, __ATOMIC_RELAXED);
+        busy_wait(TASK_TICKS);
+    }) };
+
+    check_run(stats, runs);
+    stats.report("uniform");
+}
+
+TEST_CASE_CONDITIONAL(skewed_tasks, multiple_cpus())
+{
+    std::vector<uint32_t> runs(TASKS_PER_CPU * online_cpus(), 0);
+
+    // Only the tasks in the initial block of the BSP take time, so the other
+    // CPUs run out of work quickly and have to steal.
+    auto stats{ smp::run_tasks(runs.size(), [&runs](size_t task) {
+        __atomic_add_fetch(&runs[task], 1, __ATOMIC_RELAXED);
+        if (task < TASKS_PER_CPU) {
+            busy_wait(TASK_TICKS);
+        }
+    }) };
+
+    check_run(stats, runs);
+    BARETEST_ASSERT(stats.steals() > 0);
+    stats.report("skewed");
+}
+
+BARETEST_RUN;
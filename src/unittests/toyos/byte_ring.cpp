@@ -0,0 +1,53 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/util/byte_ring.hpp>
+
+template<size_t SIZE>
+static std::string drain_to_string(cbl::byte_ring<SIZE>& ring)
+{
+    std::string content;
+    ring.drain([&content](const char* data, size_t size) { content.append(data, size); });
+    return content;
+}
+
+TEST_CASE("byte_ring: data is drained in order")
+{
+    cbl::byte_ring<8> ring;
+    CHECK(ring.empty());
+
+    ring.write("abc", 3);
+    ring.write("de", 2);
+    CHECK(ring.used() == 5);
+    CHECK(ring.dropped() == 0);
+
+    CHECK(drain_to_string(ring) == "abcde");
+    CHECK(ring.empty());
+
+    // The next write wraps around the end of the buffer.
+    ring.write("fghijk", 6);
+    CHECK(drain_to_string(ring) == "fghijk");
+}
+
+TEST_CASE("byte_ring: the oldest data is dropped on overflow")
+{
+    cbl::byte_ring<8> ring;
+
+    ring.write("012345", 6);
+    ring.write("6789", 4);
+    CHECK(ring.used() == 8);
+    CHECK(ring.dropped() == 2);
+    CHECK(drain_to_string(ring) == "23456789");
+    CHECK(ring.dropped() == 0);
+
+    // Writes larger than the ring keep their end.
+    ring.write("xy", 2);
+    ring.write("abcdefghijkl", 12);
+    CHECK(ring.dropped() == 6);
+    CHECK(drain_to_string(ring) == "efghijkl");
+}
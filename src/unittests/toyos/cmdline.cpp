@@ -15,7 +15,12 @@ TEST_CASE("parsing empty cmdline only results in defaults")
     CHECK(!parsed.serial_option().has_value());
     CHECK(!parsed.xhci_option().has_value());
     CHECK(parsed.xhci_power_option() == "0");  // default
+    CHECK(!parsed.virtio_console_option());
     CHECK(parsed.disable_testcases_option().empty());
+    CHECK(!parsed.parallel_testcases_option());
+    CHECK(parsed.latency_working_sets_option().empty());
+    CHECK(parsed.dirty_rate_option() == "0");  // default
+    CHECK(parsed.dirty_patterns_option().empty());
 }
 
 TEST_CASE("parsing '--serial'")
@@ -29,6 +34,13 @@ TEST_CASE("parsing '--serial'")
     CHECK(parsed.serial_option().value() == "0x3f8");
 }
 
+TEST_CASE("parsing '--virtio-console'")
+{
+    auto input = "--virtio-console";
+    auto parsed = cmdline::cmdline_parser(input);
+    CHECK(parsed.virtio_console_option());
+}
+
 TEST_CASE("parsing '--disable-testcases'")
 {
     auto input = "--disable-testcases=testA,testB,testC";
@@ -38,3 +50,31 @@ TEST_CASE("parsing '--disable-testcases'")
     CHECK(disable_tests[1] == "testB");
     CHECK(disable_tests[2] == "testC");
 }
+
+TEST_CASE("parsing '--parallel-testcases'")
+{
+    auto input = "--parallel-testcases";
+    auto parsed = cmdline::cmdline_parser(input);
+    CHECK(parsed.parallel_testcases_option());
+}
+
+TEST_CASE("parsing '--latency-working-sets'")
+{
+    auto input = "--latency-working-sets=32,1024";
+    auto parsed = cmdline::cmdline_parser(input);
+    auto working_sets = parsed.latency_working_sets_option();
+    REQUIRE(working_sets.size() == 2);
+    CHECK(working_sets[0] == "32");
+    CHECK(working_sets[1] == "1024");
+}
+
+TEST_CASE("parsing '--dirty-rate' and '--dirty-patterns'")
+{
+    auto input = "--dirty-rate=50000 --dirty-patterns=random,hot-set";
+    auto parsed = cmdline::cmdline_parser(input);
+    CHECK(parsed.dirty_rate_option() == "50000");
+    auto patterns = parsed.dirty_patterns_option();
+    REQUIRE(patterns.size() == 2);
+    CHECK(patterns[0] == "random");
+    CHECK(patterns[1] == "hot-set");
+}
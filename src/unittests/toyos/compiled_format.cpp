@@ -0,0 +1,53 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/printf/compiled_format.hpp>
+
+#include <string>
+
+// The printf backends are not part of the host library.
+static std::string output;
+
+void write_printf_output(const char* data, size_t size)
+{
+    output.append(data, size);
+}
+
+#define FORMAT(...)                    \
+    ([&] {                             \
+        output.clear();                \
+        compiled_pprintf(__VA_ARGS__); \
+        return output;                 \
+    }())
+
+TEST_CASE("compiled_pprintf() formats decimal numbers")
+{
+    CHECK(FORMAT("{} {} {}", 0, 1234567890, -42) == "0 1234567890 -42");
+    CHECK(FORMAT("{} {}", 18446744073709551615ul, -9223372036854775807l - 1) == "18446744073709551615 -9223372036854775808");
+    CHECK(FORMAT("[{4}] [{-4}] [{04}]", 7, 7, 7) == "[   7] [7   ] [0007]");
+}
+
+TEST_CASE("compiled_pprintf() formats hex numbers like xprintf")
+{
+    CHECK(FORMAT("{x} {#x} {#06x}", 0xabcu, 0u, 0xfful) == "abc 0x0 0x0000ff");
+    CHECK(FORMAT("{x}", -1) == "ffffffff");
+    CHECK(FORMAT("{}", reinterpret_cast<void*>(0xdead)) == "0xDEAD");
+}
+
+TEST_CASE("compiled_pprintf() formats strings and characters")
+{
+    const char* str{ "abc" };
+
+    CHECK(FORMAT("{s}|{5s}|{-5s}|", str, str, str) == "abc|  abc|abc  |");
+    CHECK(FORMAT("{} 100%%", 'x') == "x 100%");
+}
+
+TEST_CASE("compiled_pprintf() converts line endings")
+{
+    const char* str{ "a\nb" };
+
+    CHECK(FORMAT("{s}\n", str) == "a\r\nb\r\n");
+}
@@ -0,0 +1,68 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/memory/growable_heap.hpp>
+#include <toyos/memory/tlsf_heap.hpp>
+
+struct test_memory
+{
+    test_memory(size_t base, size_t size)
+        : base_(base), size_(size) {}
+
+    size_t base() const
+    {
+        return base_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t base_;
+    size_t size_;
+};
+
+using test_heap = growable_heap<tlsf_heap<>, test_memory, 4>;
+
+static constexpr size_t CHUNK_SIZE{ 64 * 1024 };
+static constexpr size_t CHUNKS{ 3 };
+
+alignas(4096) static char chunks[CHUNKS][CHUNK_SIZE];
+static size_t used_chunks{ 0 };
+
+static cbl::interval grow_test_heap(size_t min_size)
+{
+    if (used_chunks == CHUNKS or min_size > CHUNK_SIZE) {
+        return {};
+    }
+    return cbl::interval::from_size(reinterpret_cast<uintptr_t>(chunks[used_chunks++]), CHUNK_SIZE);
+}
+
+TEST_CASE("growable_heap: the heap grows when its regions are full")
+{
+    used_chunks = 0;
+    test_heap heap(grow_test_heap);
+    REQUIRE(heap.add_region(reinterpret_cast<uintptr_t>(chunks[used_chunks++]), CHUNK_SIZE));
+    CHECK(heap.num_regions() == 1);
+
+    auto* a{ heap.alloc(40 * 1024) };
+    auto* b{ heap.alloc(40 * 1024) };
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    CHECK(heap.num_regions() == 2);
+
+    // Requests that no region can ever hold fail without using up memory.
+    CHECK(heap.alloc(CHUNK_SIZE) == nullptr);
+    CHECK(heap.num_regions() == 2);
+
+    auto free_before{ heap.free_mem() };
+    heap.free(b);
+    CHECK(heap.free_mem() > free_before);
+
+    // The freed memory is reused before the heap grows again.
+    CHECK(heap.alloc(40 * 1024) == b);
+    CHECK(heap.num_regions() == 2);
+}
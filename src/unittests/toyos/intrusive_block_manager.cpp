@@ -0,0 +1,65 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <set>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/memory/buddy.hpp>
+#include <toyos/memory/intrusive_block_manager.hpp>
+
+static constexpr math::order_t SPAN_ORDER{ 16 };
+static constexpr math::order_t PAGE_ORDER{ 12 };
+
+alignas(1 << SPAN_ORDER) static char memory[1 << SPAN_ORDER];
+
+TEST_CASE("intrusive_block_manager: buddies are split and merged")
+{
+    using manager = intrusive_block_manager<SPAN_ORDER, PAGE_ORDER>;
+    auto base{ reinterpret_cast<uintptr_t>(memory) };
+
+    buddy_impl<manager> pool{ SPAN_ORDER, base };
+    buddy_reclaim_range(cbl::interval::from_order(base, SPAN_ORDER), pool);
+
+    // Every page can be allocated exactly once.
+    std::set<uintptr_t> pages;
+    for (size_t i{ 0 }; i < (1 << (SPAN_ORDER - PAGE_ORDER)); i++) {
+        auto page{ pool.alloc(PAGE_ORDER) };
+        REQUIRE(page);
+        CHECK(pages.insert(*page).second);
+        CHECK(*page >= base);
+        CHECK(*page < base + sizeof(memory));
+    }
+    CHECK(!pool.alloc(PAGE_ORDER));
+
+    // After freeing all pages, they are merged into a single block again.
+    for (auto page : pages) {
+        pool.free(page, PAGE_ORDER);
+    }
+    CHECK(pool.alloc(SPAN_ORDER) == base);
+    CHECK(!pool.alloc(PAGE_ORDER));
+}
+
+TEST_CASE("intrusive_block_manager: block ids can be page numbers")
+{
+    using manager = intrusive_block_manager<SPAN_ORDER - PAGE_ORDER, 0, PAGE_ORDER>;
+    auto base{ reinterpret_cast<uintptr_t>(memory) >> PAGE_ORDER };
+
+    // Only a part of the span is backed by memory.
+    buddy_impl<manager> pool{ 32, base };
+    buddy_reclaim_range(cbl::interval(base + 1, base + 8), pool);
+
+    auto first{ pool.alloc(2) };
+    REQUIRE(first);
+    CHECK(*first == base + 4);
+    CHECK(!pool.alloc(2));
+
+    // Allocated memory does not contain list pointers.
+    const char* block{ memory + ((*first - base) << PAGE_ORDER) };
+    CHECK(std::all_of(block, block + (size_t(1) << (PAGE_ORDER + 2)), [](char c) { return c == 0; }));
+
+    pool.free(*first, 2);
+    CHECK(pool.alloc(2) == first);
+}
@@ -0,0 +1,145 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/memory/memory_map.hpp>
+#include <toyos/multiboot2/multiboot2_builder.hpp>
+
+static std::vector<memory_region> regions_of(const memory_map& map)
+{
+    return { map.begin(), map.end() };
+}
+
+static bool operator==(const memory_region& a, const memory_region& b)
+{
+    return a.range == b.range and a.type == b.type;
+}
+
+TEST_CASE("memory_map: regions are sorted and reserved ranges are cut out")
+{
+    static memory_map map;
+    map.add({ 0x100000, 0x800000 }, memory_type::USABLE);
+    map.add({ 0, 0x9f000 }, memory_type::USABLE);
+    map.add({ 0x9f000, 0x9f000 }, memory_type::USABLE);
+
+    map.reserve({ 0x200000, 0x300000 });
+
+    std::vector<memory_region> expected{
+        { { 0, 0x9f000 }, memory_type::USABLE },
+        { { 0x100000, 0x200000 }, memory_type::USABLE },
+        { { 0x300000, 0x800000 }, memory_type::USABLE },
+    };
+    CHECK(regions_of(map) == expected);
+    CHECK(map.usable_bytes() == 0x9f000 + 0x100000 + 0x500000);
+}
+
+TEST_CASE("memory_map: Multiboot2 memory maps are parsed")
+{
+    multiboot2::mbi2_builder builder;
+    builder.add_boot_cmdline("foo");
+    builder.add_memory({
+        { 0, 0x9fc00, multiboot2::mmap_entry::MMAP_AVAILABLE },
+        { 0xf0000, 0x10000, 2 },
+        { 0x100000, 0x7ff00000, multiboot2::mmap_entry::MMAP_AVAILABLE },
+        // Firmware tables inside of usable memory
+        { 0x7fe00000, 0x100000, 3 },
+        { 0x100000000, 0x40000000, multiboot2::mmap_entry::MMAP_AVAILABLE },
+    });
+    auto mbi{ builder.build() };
+
+    static memory_map map;
+    map.add_multiboot2(multiboot2::mbi2_reader(mbi.data()));
+
+    std::vector<memory_region> expected{
+        { { 0, 0x9fc00 }, memory_type::USABLE },
+        { { 0xf0000, 0x100000 }, memory_type::RESERVED },
+        { { 0x100000, 0x7fe00000 }, memory_type::USABLE },
+        { { 0x7fe00000, 0x7ff00000 }, memory_type::ACPI_RECLAIMABLE },
+        { { 0x7ff00000, 0x80000000 }, memory_type::USABLE },
+        { { 0x100000000, 0x140000000 }, memory_type::USABLE },
+    };
+    CHECK(regions_of(map) == expected);
+}
+
+TEST_CASE("memory_map: Multiboot1 and Xen PVH memory maps are parsed")
+{
+    std::vector<multiboot::multiboot_mmap_entry> mb1_entries{
+        { 20, 0, 0x9fc00, 1 },
+        { 20, 0x100000, 0x1000000, 1 },
+        { 20, 0xfec00000, 0x1000, 2 },
+    };
+
+    static memory_map mb1_map;
+    mb1_map.add_multiboot1_entries(reinterpret_cast<const uint8_t*>(mb1_entries.data()), mb1_entries.size() * sizeof(mb1_entries[0]));
+    CHECK(mb1_map.size() == 3);
+    CHECK(mb1_map.usable_bytes() == 0x9fc00 + 0x1000000);
+
+    std::vector<xen_pvh::hvm_memmap_table_entry> pvh_entries{
+        { 0, 0xa0000, XEN_HVM_MEMMAP_TYPE_RAM, 0 },
+        { 0x100000, 0x3ff00000, XEN_HVM_MEMMAP_TYPE_RAM, 0 },
+    };
+    xen_pvh::hvm_start_info info{};
+    info.version = 1;
+    info.memmap_paddr = reinterpret_cast<uintptr_t>(pvh_entries.data());
+    info.memmap_entries = static_cast<uint32_t>(pvh_entries.size());
+
+    static memory_map pvh_map;
+    pvh_map.add_xen_pvh(info);
+    CHECK(pvh_map.usable_bytes() == 0xa0000 + 0x3ff00000);
+
+    // Version 0 has no memory map.
+    info.version = 0;
+    static memory_map empty_map;
+    empty_map.add_xen_pvh(info);
+    CHECK(empty_map.empty());
+}
+
+TEST_CASE("memory_map: adjacent and overlapping regions of the same type are merged")
+{
+    static memory_map map;
+    map.add({ 0x100000, 0x200000 }, memory_type::USABLE);
+    map.add({ 0x200000, 0x300000 }, memory_type::USABLE);
+    map.add({ 0x280000, 0x400000 }, memory_type::USABLE);
+    map.add({ 0x400000, 0x500000 }, memory_type::RESERVED);
+    map.add({ 0x500000, 0x600000 }, memory_type::USABLE);
+
+    std::vector<memory_region> expected{
+        { { 0x100000, 0x400000 }, memory_type::USABLE },
+        { { 0x400000, 0x500000 }, memory_type::RESERVED },
+        { { 0x500000, 0x600000 }, memory_type::USABLE },
+    };
+    CHECK(regions_of(map) == expected);
+}
+
+TEST_CASE("memory_map: a full map drops regions and keeps usable memory")
+{
+    static memory_map map;
+
+    // Alternating types can't be merged.
+    for (uint64_t i{ 0 }; i < memory_map::MAX_REGIONS; i++) {
+        map.add(cbl::interval::from_size(i * 0x2000, 0x1000 + (i % 2) * 0x1000), i % 2 ? memory_type::USABLE : memory_type::RESERVED);
+    }
+    REQUIRE(map.size() == memory_map::MAX_REGIONS);
+
+    auto usable_before{ map.usable_bytes() };
+    map.add(cbl::interval::from_size(0x10000000, 0x1000), memory_type::USABLE);
+
+    CHECK(map.size() == memory_map::MAX_REGIONS);
+    CHECK(map.usable_bytes() == usable_before + 0x1000);
+
+    // Reserved regions that overlap usable memory are never dropped, so the
+    // smallest usable region goes.
+    static memory_map usable_map;
+    for (uint64_t i{ 0 }; i < memory_map::MAX_REGIONS; i++) {
+        usable_map.add(cbl::interval::from_size(i * 0x100000, 0x1000 * (i + 1)), memory_type::USABLE);
+    }
+    REQUIRE(usable_map.size() == memory_map::MAX_REGIONS);
+
+    usable_map.add({ 0x0, 0x10 }, memory_type::RESERVED);
+    CHECK(usable_map.size() == memory_map::MAX_REGIONS);
+    CHECK(usable_map.begin()->type == memory_type::RESERVED);
+}
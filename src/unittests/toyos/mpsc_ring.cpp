@@ -0,0 +1,43 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/util/mpsc_ring.hpp>
+
+TEST_CASE("mpsc_ring: elements are consumed in FIFO order")
+{
+    cbl::mpsc_ring<int, 4> ring;
+    CHECK(ring.empty());
+
+    CHECK(ring.push(1));
+    CHECK(ring.push(2));
+    CHECK(!ring.empty());
+
+    std::vector<int> consumed;
+    auto collect = [&consumed](const int& v) { consumed.push_back(v); };
+
+    CHECK(ring.consume(collect));
+    CHECK(ring.consume(collect));
+    CHECK(!ring.consume(collect));
+    CHECK(consumed == std::vector<int>{ 1, 2 });
+    CHECK(ring.empty());
+}
+
+TEST_CASE("mpsc_ring: producers fail when the ring is full")
+{
+    cbl::mpsc_ring<int, 2> ring;
+    auto ignore = [](const int&) {};
+
+    for (int round = 0; round < 3; round++) {
+        CHECK(ring.push(round));
+        CHECK(ring.emplace([](int& v) { v = 42; }));
+        CHECK(!ring.push(0));
+
+        CHECK(ring.consume(ignore));
+        CHECK(ring.consume(ignore));
+    }
+}
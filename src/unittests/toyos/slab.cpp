@@ -0,0 +1,76 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <set>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/memory/slab.hpp>
+
+static constexpr size_t TEST_PAGES{ 4 };
+
+alignas(PAGE_SIZE) static char pages[TEST_PAGES][PAGE_SIZE];
+static size_t used_pages{ 0 };
+
+static void* alloc_test_page()
+{
+    return used_pages < TEST_PAGES ? pages[used_pages++] : nullptr;
+}
+
+TEST_CASE("slab_cache: objects are reused and counted")
+{
+    used_pages = 0;
+    slab_cache cache(100, alloc_test_page);
+    CHECK(cache.object_size() == 112);
+
+    auto* a{ cache.alloc() };
+    auto* b{ cache.alloc() };
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    CHECK(a != b);
+    CHECK(reinterpret_cast<uintptr_t>(a) % slab_cache::OBJECT_ALIGNMENT == 0);
+    CHECK(&slab_cache::owner(a) == &cache);
+
+    cache.free(a);
+    CHECK(cache.alloc() == a);
+
+    CHECK(cache.stats().allocations == 3);
+    CHECK(cache.stats().frees == 1);
+    CHECK(cache.stats().objects_in_use == 2);
+    CHECK(cache.stats().pages == 1);
+}
+
+TEST_CASE("slab_cache: allocation fails when the page source is empty")
+{
+    used_pages = TEST_PAGES - 1;
+    slab_cache cache(1024, alloc_test_page);
+
+    std::set<void*> objects;
+    while (auto* obj{ cache.alloc() }) {
+        CHECK(objects.insert(obj).second);
+    }
+
+    // The page header leaves room for three objects only.
+    CHECK(objects.size() == 3);
+    CHECK(cache.stats().pages == 1);
+    CHECK(cache.stats().failed_allocations == 1);
+}
+
+TEST_CASE("slab_allocator: sizes are served by the smallest fitting cache")
+{
+    used_pages = 0;
+    slab_allocator slabs(alloc_test_page);
+
+    auto* small{ slabs.alloc(1) };
+    auto* medium{ slabs.alloc(33) };
+    REQUIRE(small != nullptr);
+    REQUIRE(medium != nullptr);
+    CHECK(slab_cache::owner(small).object_size() == 16);
+    CHECK(slab_cache::owner(medium).object_size() == 64);
+    CHECK(slabs.alloc(slab_allocator::MAX_SIZE + 1) == nullptr);
+
+    slab_allocator::free(medium);
+    CHECK(slabs.caches()[2].stats().objects_in_use == 0);
+    CHECK(slabs.caches()[2].stats().frees == 1);
+}
@@ -0,0 +1,92 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/memory/tlsf_heap.hpp>
+
+static constexpr size_t HEAP_SIZE{ 256 * 1024 };
+alignas(16) static char heap_memory[HEAP_SIZE];
+
+TEST_CASE("tlsf_heap: memory is reused after free")
+{
+    tlsf_heap<> heap(reinterpret_cast<uintptr_t>(heap_memory), HEAP_SIZE);
+    auto initial_free{ heap.free_mem() };
+
+    auto* a{ heap.alloc(100) };
+    auto* b{ heap.alloc(0) };
+    REQUIRE(a != nullptr);
+    REQUIRE(b != nullptr);
+    CHECK(reinterpret_cast<uintptr_t>(a) % heap.alignment() == 0);
+    CHECK(reinterpret_cast<uintptr_t>(b) % heap.alignment() == 0);
+    CHECK(heap.free_mem() < initial_free);
+
+    heap.free(a);
+    heap.free(b);
+    CHECK(heap.free_mem() == initial_free);
+
+    // After merging, most of the heap is available as one block again. The
+    // search rounds the size up to the next list, so the exact size of the
+    // largest block may not be found.
+    auto* large{ heap.alloc(initial_free * 3 / 4) };
+    CHECK(large != nullptr);
+    CHECK(heap.alloc(initial_free / 2) == nullptr);
+    heap.free(large);
+    CHECK(heap.free_mem() == initial_free);
+
+    CHECK(heap.alloc(HEAP_SIZE) == nullptr);
+}
+
+TEST_CASE("tlsf_heap: random allocations don't overlap")
+{
+    tlsf_heap<> heap(reinterpret_cast<uintptr_t>(heap_memory), HEAP_SIZE);
+    auto initial_free{ heap.free_mem() };
+
+    struct allocation
+    {
+        unsigned char* ptr;
+        size_t size;
+        unsigned char pattern;
+    };
+
+    std::vector<allocation> live;
+    std::mt19937 rng{ 42 };
+
+    auto check_and_free = [&heap, &live](size_t idx) {
+        auto a{ live[idx] };
+        for (size_t i{ 0 }; i < a.size; i++) {
+            REQUIRE(a.ptr[i] == a.pattern);
+        }
+        heap.free(a.ptr);
+        live.erase(live.begin() + static_cast<long>(idx));
+    };
+
+    for (unsigned round{ 0 }; round < 5000; round++) {
+        if (not live.empty() and rng() % 3 == 0) {
+            check_and_free(rng() % live.size());
+            continue;
+        }
+
+        auto size{ size_t(1) << (rng() % 13) };
+        size += rng() % size;
+
+        auto* p{ static_cast<unsigned char*>(heap.alloc(size)) };
+        if (p == nullptr) {
+            continue;
+        }
+
+        auto pattern{ static_cast<unsigned char>(rng()) };
+        memset(p, pattern, size);
+        live.push_back({ p, size, pattern });
+    }
+
+    while (not live.empty()) {
+        check_and_free(live.size() - 1);
+    }
+    CHECK(heap.free_mem() == initial_free);
+}
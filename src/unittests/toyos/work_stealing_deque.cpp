@@ -0,0 +1,61 @@
+// Copyright © 2024 Cyberus Technology GmbH <contact@cyberus-technology.de>
+//
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <toyos/util/work_stealing_deque.hpp>
+
+using deque = cbl::work_stealing_deque<int, 4>;
+
+TEST_CASE("work_stealing_deque: owner pops in LIFO order")
+{
+    deque d;
+    CHECK(d.empty());
+
+    CHECK(d.push(1));
+    CHECK(d.push(2));
+    CHECK(d.push(3));
+    CHECK(d.size() == 3);
+
+    CHECK(d.pop() == 3);
+    CHECK(d.pop() == 2);
+    CHECK(d.pop() == 1);
+    CHECK(!d.pop().has_value());
+    CHECK(d.empty());
+}
+
+TEST_CASE("work_stealing_deque: thieves steal in FIFO order")
+{
+    deque d;
+    CHECK(d.push(1));
+    CHECK(d.push(2));
+    CHECK(d.push(3));
+
+    CHECK(d.steal() == 1);
+    CHECK(d.pop() == 3);
+    CHECK(d.steal() == 2);
+    CHECK(!d.steal().has_value());
+    CHECK(!d.pop().has_value());
+}
+
+TEST_CASE("work_stealing_deque: capacity is respected across wrap-around")
+{
+    deque d;
+    for (int i = 0; i < 4; i++) {
+        CHECK(d.push(i));
+    }
+    CHECK(!d.push(4));
+
+    CHECK(d.steal() == 0);
+    CHECK(d.steal() == 1);
+    CHECK(d.push(4));
+    CHECK(d.push(5));
+    CHECK(!d.push(6));
+
+    CHECK(d.pop() == 5);
+    CHECK(d.pop() == 4);
+    CHECK(d.pop() == 3);
+    CHECK(d.pop() == 2);
+    CHECK(d.empty());
+}